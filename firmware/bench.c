@@ -0,0 +1,797 @@
+/*
+  'SID GUTS' firmware - cycle benchmark instrumentation
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "uu_time.h"
+#include "uu_stack.h"
+#include "bench.h"
+#include "sid.h"
+#include "sample.h"
+#include "mod.h"
+#include "ctl.h"
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+
+#include "avr_mcu_section.h"
+
+AVR_MCU(F_CPU, "atmega328p");
+AVR_MCU_SIMAVR_CONSOLE(&GPIOR0);
+
+/* Mux channels as wired in main.c */
+#define CCHAN_SWITCH_FILTER   7
+#define CCHAN_SWITCH_RINGSYNC 9
+#define CCHAN_CV              10
+#define CCHAN_SWITCH_WAVEFORM 13
+
+#define SWITCH_ON  1023
+#define SWITCH_OFF 0
+
+#define BENCH_SAMPLE_TICK 2 /* kick plays under the rest of the run */
+#define BENCH_IDLE_MS     2 /* main loop idle while Timer2 stack is measured */
+
+typedef struct _BenchInput
+{
+  uint8_t tick;
+  uint8_t chan;
+  int     value;
+} BenchInput;
+
+/* What the panel does during the run, applied before each tick. Press
+   and release each take two ticks to count, so presses are held two
+   and spaced four apart */
+const BenchInput bench_script[] PROGMEM = {
+  {  2, CCHAN_CV,              700 },       /* CV step */
+  {  4, CCHAN_SWITCH_WAVEFORM, SWITCH_ON }, /* next waveform */
+  {  6, CCHAN_SWITCH_WAVEFORM, SWITCH_OFF },
+  {  8, CCHAN_SWITCH_FILTER,   SWITCH_ON }, /* next filter */
+  { 10, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  { 12, CCHAN_SWITCH_RINGSYNC, SWITCH_ON }, /* ring on */
+  { 14, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 16, CCHAN_SWITCH_RINGSYNC, SWITCH_ON }, /* sync on */
+  { 18, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 19, 6 /* filter */,        900 },
+  { 20, 4 /* pwm */,           100 },
+  { 20, CCHAN_SWITCH_FILTER,   SWITCH_ON }, /* tuning on */
+  { 20, CCHAN_SWITCH_RINGSYNC, SWITCH_ON },
+  { 22, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  { 22, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 24, CCHAN_SWITCH_FILTER,   SWITCH_ON }, /* tuning off + save */
+  { 24, CCHAN_SWITCH_RINGSYNC, SWITCH_ON },
+  { 26, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  { 26, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 28, CCHAN_SWITCH_WAVEFORM, SWITCH_ON }, /* gate off */
+  { 28, CCHAN_SWITCH_RINGSYNC, SWITCH_ON },
+  { 30, CCHAN_SWITCH_WAVEFORM, SWITCH_OFF },
+  { 30, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 32, CCHAN_SWITCH_WAVEFORM, SWITCH_ON }, /* gate back on */
+  { 34, CCHAN_SWITCH_WAVEFORM, SWITCH_OFF },
+  { 36, CCHAN_SWITCH_WAVEFORM, SWITCH_ON }, /* unison on */
+  { 36, CCHAN_SWITCH_FILTER,   SWITCH_ON },
+  { 38, CCHAN_SWITCH_WAVEFORM, SWITCH_OFF },
+  { 38, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+};
+
+#define BENCH_SCRIPT_N (sizeof(bench_script)/sizeof(BenchInput))
+
+#ifdef BENCH_WCET
+/* Slow paths stacked up before the random part: saves on release
+   landing with ring/sync coming on, a waveform change and every pot
+   moving at once */
+const BenchInput wcet_script[] PROGMEM = {
+  {  2, CCHAN_SWITCH_WAVEFORM, SWITCH_ON }, /* unison on */
+  {  2, CCHAN_SWITCH_FILTER,   SWITCH_ON },
+  {  4, CCHAN_SWITCH_WAVEFORM, SWITCH_OFF },
+  {  4, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  {  6, CCHAN_SWITCH_FILTER,   SWITCH_ON }, /* tuning on */
+  {  6, CCHAN_SWITCH_RINGSYNC, SWITCH_ON },
+  {  8, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  {  8, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 10, CCHAN_SWITCH_RINGSYNC, SWITCH_ON }, /* tune up, held */
+  { 40, CCHAN_SWITCH_FILTER,   SWITCH_ON }, /* tuning off + save */
+  { 42, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  { 42, CCHAN_SWITCH_RINGSYNC, SWITCH_OFF },
+  { 44, 14 /* ring/sync */,    1023 },      /* with the settings save */
+  { 44, 12 /* waveform */,     200 },
+  { 44, CCHAN_CV,              1023 },
+  { 44, 4 /* pwm */,           0 },
+  { 44, 6 /* filter */,        1023 },
+  { 44, 5 /* res */,           1023 },
+  { 44, 15 /* detune */,       1023 },
+  { 46, CCHAN_SWITCH_FILTER,   SWITCH_ON }, /* next filter */
+  { 48, CCHAN_SWITCH_FILTER,   SWITCH_OFF },
+  { 50, 14 /* ring/sync */,    600 },       /* sync, with the save */
+  { 50, 12 /* waveform */,     900 },
+  { 50, CCHAN_CV,              0 },
+};
+
+#define WCET_SCRIPT_N (sizeof(wcet_script)/sizeof(BenchInput))
+#define WCET_RANDOM_AT 53
+
+/* Pot readings either side of the thresholds main.c switches on */
+const int wcet_levels[] PROGMEM = {
+  0, 50, 51, 100, 101, 300, 301, 350, 351, 550, 551, 750, 751, 775, 776, 1023
+};
+
+#define WCET_EEPROM_N 4 /* settings, tune and unison bytes */
+#endif
+
+const char bench_name_cycle[] PROGMEM       = "cycle";
+const char bench_name_sid_poke[] PROGMEM    = "SID_poke";
+const char bench_name_leds[] PROGMEM        = "leds_set_mask";
+const char bench_name_analog_read[] PROGMEM = "analog_read";
+const char bench_name_select_chan[] PROGMEM = "select_chan";
+const char bench_name_timer2[] PROGMEM      = "timer2_isr";
+const char bench_name_ctl[] PROGMEM         = "ctl_run";
+
+PGM_P const bench_names[BENCH_N] PROGMEM = {
+  bench_name_cycle,
+  bench_name_sid_poke,
+  bench_name_leds,
+  bench_name_analog_read,
+  bench_name_select_chan,
+  bench_name_timer2,
+  bench_name_ctl
+};
+
+static volatile uint16_t _bench_ovf;
+static uint32_t _bench_start[BENCH_N];
+static uint32_t _bench_cycles[BENCH_N];
+static uint16_t _bench_calls[BENCH_N];
+static uint16_t _bench_overhead;
+static int      _bench_inputs[16];
+static uint8_t  _bench_chan;
+
+#ifdef BENCH_LATENCY
+/* One CV step, times along the path it takes to the chip */
+typedef struct _BenchLatency
+{
+  uint32_t step;   /* the CV moves */
+  uint32_t cycle;  /* the tick that read it started */
+  uint32_t select; /* its CV mux select started */
+  uint32_t adc;    /* conversion started */
+  uint32_t conv;   /* and finished */
+  uint32_t bus;    /* first frequency register write started */
+  uint32_t end;    /* both frequency registers hold the new value */
+  int      cv;     /* reading after the step */
+  bool     read;
+  bool     writing;
+  bool     done;
+} BenchLatency;
+
+#define LAT_PHASE   0
+#define LAT_SCAN    1
+#define LAT_MUX     2
+#define LAT_CONV    3
+#define LAT_COMPUTE 4
+#define LAT_BUS     5
+#define LAT_N       6
+
+const char lat_name_phase[] PROGMEM   = "tick_phase";
+const char lat_name_scan[] PROGMEM    = "scan";
+const char lat_name_mux[] PROGMEM     = "mux_settle";
+const char lat_name_conv[] PROGMEM    = "conversion";
+const char lat_name_compute[] PROGMEM = "compute";
+const char lat_name_bus[] PROGMEM     = "bus_write";
+
+PGM_P const lat_names[LAT_N] PROGMEM = {
+  lat_name_phase,
+  lat_name_scan,
+  lat_name_mux,
+  lat_name_conv,
+  lat_name_compute,
+  lat_name_bus
+};
+
+static BenchLatency _lat;
+static uint16_t     _lat_total[BENCH_LATENCY_STEPS]; /* us */
+#endif
+
+void cycle();
+void soundcheck_start(bool repeat);
+void settings_save();
+void tuning_save();
+bool soundcheck_running();
+
+extern uint8_t _ramp_pw_voices;
+
+ISR(TIMER1_OVF_vect)
+{
+  _bench_ovf++;
+}
+
+static uint32_t
+bench_now()
+{
+  uint8_t  sreg = SREG;
+  uint16_t lo, hi;
+
+  cli();
+  lo = TCNT1;
+  hi = _bench_ovf;
+  /* overflow pending but not yet serviced */
+  if ((TIFR1 & _BV(TOV1)) && lo < 0x8000)
+    hi++;
+  SREG = sreg;
+
+  return ((uint32_t)hi << 16) | lo;
+}
+
+static void
+bench_putc(char c)
+{
+  GPIOR0 = c;
+}
+
+static void
+bench_puts_P(PGM_P s)
+{
+  char c;
+
+  while ((c = pgm_read_byte(s++)))
+    bench_putc(c);
+}
+
+static void
+bench_putu(uint32_t v)
+{
+  char buf[10];
+  uint8_t n = 0;
+
+  do
+    {
+      buf[n++] = '0' + (v % 10);
+      v /= 10;
+    }
+  while (v);
+
+  while (n)
+    bench_putc(buf[--n]);
+}
+
+static void
+bench_line(uint8_t tick, uint8_t id)
+{
+  uint8_t sreg = SREG;
+
+  cli(); /* no trace lines from the Timer2 interrupt in the middle */
+  bench_puts_P(PSTR("bench,"));
+  bench_putu(tick);
+  bench_putc(',');
+  bench_puts_P((PGM_P)pgm_read_word(&bench_names[id]));
+  bench_putc(',');
+  bench_putu(_bench_cycles[id]);
+  bench_putc(',');
+  bench_putu(_bench_calls[id]);
+  bench_putc('\n');
+  SREG = sreg;
+}
+
+void
+bench_enter(uint8_t id)
+{
+  _bench_start[id] = bench_now();
+}
+
+void
+bench_leave(uint8_t id)
+{
+  uint32_t t = bench_now() - _bench_start[id];
+
+  _bench_cycles[id] += (t > _bench_overhead) ? t - _bench_overhead : 0;
+  _bench_calls[id]++;
+}
+
+void
+bench_select_chan(int chan)
+{
+  _bench_chan = chan & 0x0f;
+}
+
+int
+bench_adc(int value)
+{
+#ifdef BENCH_LATENCY
+  uint32_t now = bench_now();
+
+  /* The step shows up at the first CV conversion finishing after it */
+  if (_bench_chan == CCHAN_CV && (int32_t)(now - _lat.step) >= 0)
+    {
+      if (!_lat.read)
+	{
+	  _lat.read   = TRUE;
+	  _lat.cycle  = _bench_start[BENCH_CYCLE];
+	  _lat.select = _bench_start[BENCH_SELECT_CHAN];
+	  _lat.adc    = _bench_start[BENCH_ANALOG_READ];
+	  _lat.conv   = now;
+	}
+      return _lat.cv;
+    }
+#endif
+
+  /* The conversion was still run and timed, only the result is faked */
+  return _bench_inputs[_bench_chan];
+}
+
+/* Stack bytes a context took below bench_run() */
+static void
+bench_stack_line(PGM_P tick, uint8_t n, PGM_P context, uint16_t bytes)
+{
+  bench_puts_P(PSTR("stack,"));
+  if (tick)
+    bench_puts_P(tick);
+  else
+    bench_putu(n);
+  bench_putc(',');
+  bench_puts_P(context);
+  bench_putc(',');
+  bench_putu(bytes);
+  bench_putc('\n');
+}
+
+/* 0 if a voice on the pulse width ramp holds other than voice 1's */
+static void
+bench_check_pw(uint8_t tick)
+{
+  uint8_t v, ok = 1;
+
+  for (v = 1; v < 3; v++)
+    if ((_ramp_pw_voices & (1<<v))
+	&& (_shadow.regs[v * SID_VOICE_2 + 2] != _shadow.regs[2]
+	    || _shadow.regs[v * SID_VOICE_2 + 3] != _shadow.regs[3]))
+      ok = 0;
+
+  bench_puts_P(PSTR("check,"));
+  bench_putu(tick);
+  bench_puts_P(PSTR(",pw_voices,"));
+  bench_putu(ok);
+  bench_putc('\n');
+}
+
+#if defined(BENCH_WCET) || defined(BENCH_LATENCY)
+static uint16_t _bench_rand;
+
+/* xorshift, full 16 bit period */
+static uint16_t
+bench_rand()
+{
+  _bench_rand ^= _bench_rand << 7;
+  _bench_rand ^= _bench_rand >> 9;
+  _bench_rand ^= _bench_rand << 8;
+
+  return _bench_rand;
+}
+#endif
+
+#ifdef BENCH_WCET
+
+/* Switches flip now and then, pots jump to a threshold or anywhere,
+   or jitter by a step */
+static void
+wcet_inputs()
+{
+  uint8_t  chan;
+  uint16_t r;
+  int      v;
+
+  for (chan = 0; chan < 16; chan++)
+    {
+      r = bench_rand();
+
+      if (chan == CCHAN_SWITCH_FILTER || chan == CCHAN_SWITCH_RINGSYNC
+	  || chan == CCHAN_SWITCH_WAVEFORM)
+	{
+	  if ((r & 7) == 0)
+	    _bench_inputs[chan] = _bench_inputs[chan] ? SWITCH_OFF : SWITCH_ON;
+	  continue;
+	}
+
+      v = _bench_inputs[chan];
+      if ((r & 31) == 0)
+	v = pgm_read_word(&wcet_levels[(r >> 5) & 15]);
+      else if ((r & 31) == 1)
+	v = r >> 6;
+      else if ((r & 3) == 2)
+	v += (r & 4) ? 1 : -1;
+
+      _bench_inputs[chan] = MIN(MAX(v, 0), 1023);
+    }
+}
+
+/* Bytes that differ, each was a full EEPROM write */
+static uint8_t
+wcet_eeprom(uint8_t *image)
+{
+  uint8_t now[WCET_EEPROM_N], i, n = 0;
+
+  eeprom_read_block(now, 0, WCET_EEPROM_N);
+  for (i = 0; i < WCET_EEPROM_N; i++)
+    if (now[i] != image[i])
+      {
+	image[i] = now[i];
+	n++;
+      }
+
+  return n;
+}
+
+static void
+wcet_line(PGM_P what, uint32_t a, uint32_t b, uint32_t c)
+{
+  bench_puts_P(PSTR("wcet,"));
+  bench_puts_P(what);
+  bench_putc(',');
+  bench_putu(a);
+  bench_putc(',');
+  bench_putu(b);
+  bench_putc(',');
+  bench_putu(c);
+  bench_putc('\n');
+}
+
+/* Slowest tick and the inputs before and at it, so it can be replayed */
+static void
+bench_wcet()
+{
+  uint8_t  image[WCET_EEPROM_N];
+  int      before[16], prev[16], worst_in[16];
+  uint32_t t, worst = 0;
+  uint16_t tick, worst_tick = 0;
+  uint8_t  s = 0, n, worst_ee = 0, chan;
+
+  _bench_rand = BENCH_WCET_SEED;
+
+  /* As a unit that has saved before, a blank EEPROM would have the
+     first save write every byte */
+  tuning_save();
+  settings_save();
+  eeprom_read_block(image, 0, WCET_EEPROM_N);
+
+  for (tick = 0; tick < BENCH_WCET_TICKS; tick++)
+    {
+      memcpy(prev, _bench_inputs, sizeof(prev));
+
+      if (tick < WCET_RANDOM_AT)
+	while (s < WCET_SCRIPT_N
+	       && pgm_read_byte(&wcet_script[s].tick) == tick)
+	  {
+	    _bench_inputs[pgm_read_byte(&wcet_script[s].chan)]
+	      = pgm_read_word(&wcet_script[s].value);
+	    s++;
+	  }
+      else
+	wcet_inputs();
+
+      t = bench_now();
+      cycle();
+      t = bench_now() - t - _bench_overhead;
+
+      n = wcet_eeprom(image);
+      t += n * BENCH_EEPROM_CYCLES;
+
+      if (t > worst)
+	{
+	  worst      = t;
+	  worst_tick = tick;
+	  worst_ee   = n;
+	  memcpy(before, prev, sizeof(before));
+	  memcpy(worst_in, _bench_inputs, sizeof(worst_in));
+	}
+    }
+
+  bench_puts_P(PSTR("wcet,what,a,b,c\n"));
+  wcet_line(PSTR("seed"), BENCH_WCET_SEED, BENCH_WCET_TICKS, WCET_RANDOM_AT);
+  wcet_line(PSTR("worst"), worst, worst_tick, worst_ee);
+  for (chan = 0; chan < 16; chan++)
+    wcet_line(PSTR("input"), chan, before[chan], worst_in[chan]);
+  wcet_line(PSTR("budget"), BENCH_WCET_BUDGET, worst,
+	    worst <= BENCH_WCET_BUDGET);
+}
+#endif
+
+#ifdef BENCH_LATENCY
+/* Next step somewhere in the tick period after 'tick', to a reading at
+   least a few semitones away */
+static void
+latency_arm(uint32_t tick)
+{
+  _bench_inputs[CCHAN_CV] = _lat.cv;
+
+  memset(&_lat, 0, sizeof(_lat));
+  _lat.step = tick + ((uint32_t)bench_rand() * (BENCH_TICK_CYCLES >> 6) >> 10);
+  _lat.cv   = (_bench_inputs[CCHAN_CV] + 64 + bench_rand() % 896) & 1023;
+}
+
+/* Time in [from, to) after the step, so the parts add up to the total */
+static uint16_t
+latency_part(uint32_t from, uint32_t to)
+{
+  if ((int32_t)(from - _lat.step) < 0)
+    from = _lat.step;
+  if ((int32_t)(to - from) <= 0)
+    return 0;
+
+  return (to - from) / (F_CPU / 1000000);
+}
+
+static void
+latency_line(PGM_P what, uint16_t a, uint16_t b, uint16_t c, uint16_t d)
+{
+  bench_puts_P(PSTR("latency,"));
+  bench_puts_P(what);
+  bench_putc(',');
+  bench_putu(a);
+  bench_putc(',');
+  bench_putu(b);
+  bench_putc(',');
+  bench_putu(c);
+  bench_putc(',');
+  bench_putu(d);
+  bench_putc('\n');
+}
+
+/*
+ * CV steps at random points in the tick period, timed from the step to
+ * SID registers 0/1 holding the new frequency. Ticks run on the real
+ * 20ms period with Timer2 going in between. Each step is split into the
+ * wait for the tick to come round, the scan before the CV channel, its
+ * mux settle and conversion, compute, then the bus writes. In us
+ */
+static void
+bench_latency()
+{
+  uint16_t part[LAT_N], lo[LAT_N], hi[LAT_N], t;
+  uint32_t sum[LAT_N], tick;
+  uint16_t n = 0, i, j, lost = 0;
+  uint8_t  p;
+
+  _bench_rand = BENCH_LATENCY_SEED;
+  memset(sum, 0, sizeof(sum));
+  memset(hi, 0, sizeof(hi));
+  memset(lo, 0xff, sizeof(lo));
+
+  tick = bench_now() + BENCH_TICK_CYCLES;
+  _lat.cv = _bench_inputs[CCHAN_CV];
+  latency_arm(tick);
+
+  bench_puts_P(PSTR("latency,step,total,"));
+  for (p = 0; p < LAT_N; p++)
+    {
+      bench_puts_P((PGM_P)pgm_read_word(&lat_names[p]));
+      bench_putc(p < LAT_N - 1 ? ',' : '\n');
+    }
+
+  while (n < BENCH_LATENCY_STEPS)
+    {
+      while ((int32_t)(bench_now() - tick) < 0)
+	;
+      tick += BENCH_TICK_CYCLES;
+
+      cycle();
+
+      if (_lat.read && !_lat.done)
+	{
+	  lost++; /* read, but the frequency never changed */
+	  latency_arm(tick);
+	  continue;
+	}
+      if (!_lat.done)
+	continue;
+
+      part[LAT_PHASE]   = latency_part(_lat.step, _lat.cycle);
+      part[LAT_SCAN]    = latency_part(_lat.cycle, _lat.select);
+      part[LAT_MUX]     = latency_part(_lat.select, _lat.adc);
+      part[LAT_CONV]    = latency_part(_lat.adc, _lat.conv);
+      part[LAT_COMPUTE] = latency_part(_lat.conv, _lat.bus);
+      part[LAT_BUS]     = latency_part(_lat.bus, _lat.end);
+
+      _lat_total[n] = latency_part(_lat.step, _lat.end);
+
+      bench_puts_P(PSTR("latency,"));
+      bench_putu(n);
+      bench_putc(',');
+      bench_putu(_lat_total[n]);
+      for (p = 0; p < LAT_N; p++)
+	{
+	  bench_putc(',');
+	  bench_putu(part[p]);
+	  sum[p] += part[p];
+	  lo[p] = MIN(lo[p], part[p]);
+	  hi[p] = MAX(hi[p], part[p]);
+	}
+      bench_putc('\n');
+
+      n++;
+      latency_arm(tick);
+    }
+
+  /* Insertion sort, for the percentiles */
+  for (i = 1; i < n; i++)
+    {
+      t = _lat_total[i];
+      for (j = i; j > 0 && _lat_total[j - 1] > t; j--)
+	_lat_total[j] = _lat_total[j - 1];
+      _lat_total[j] = t;
+    }
+
+  bench_puts_P(PSTR("latency,what,min,median,p99,max\n"));
+  latency_line(PSTR("total"), _lat_total[0], _lat_total[(n + 1) / 2 - 1],
+	       _lat_total[(n * 99 + 99) / 100 - 1], _lat_total[n - 1]);
+
+  bench_puts_P(PSTR("latency,what,min,mean,max,lost\n"));
+  for (p = 0; p < LAT_N; p++)
+    latency_line((PGM_P)pgm_read_word(&lat_names[p]), lo[p], sum[p] / n,
+		 hi[p], lost);
+
+  /* Histogram, empty buckets left out */
+  bench_puts_P(PSTR("latency,hist,from_us,count\n"));
+  for (i = 0; i < n; i = j)
+    {
+      t = _lat_total[i] / BENCH_LATENCY_BUCKET * BENCH_LATENCY_BUCKET;
+      for (j = i; j < n && _lat_total[j] < t + BENCH_LATENCY_BUCKET; j++)
+	;
+      bench_puts_P(PSTR("latency,hist,"));
+      bench_putu(t);
+      bench_putc(',');
+      bench_putu(j - i);
+      bench_putc('\n');
+    }
+}
+
+/* Frequency writes for the step, done once neither register is dirty */
+void
+sid_trace (uint8_t chip, uint8_t port, uint8_t data)
+{
+  if (chip != 0 || port > 1 || !_lat.read || _lat.done)
+    return;
+
+  if (!_lat.writing)
+    {
+      _lat.writing = TRUE;
+      _lat.bus = _bench_start[BENCH_SID_POKE];
+    }
+
+  if (!(_shadow.dirty & (CTL_REG(0)|CTL_REG(1))))
+    {
+      _lat.end  = bench_now();
+      _lat.done = TRUE;
+    }
+}
+#elif defined(SID_TRACE)
+void
+sid_trace (uint8_t chip, uint8_t port, uint8_t data)
+{
+  uint8_t sreg = SREG;
+
+  cli();
+  bench_puts_P(PSTR("trace,"));
+  bench_putu(bench_now());
+  bench_putc(',');
+  bench_putu(chip);
+  bench_putc(',');
+  bench_putu(port);
+  bench_putc(',');
+  bench_putu(data);
+  bench_putc('\n');
+  SREG = sreg;
+}
+#endif
+
+void
+bench_init()
+{
+  uint8_t i;
+
+  /* Timer1 becomes the cycle counter, the control tick is driven below */
+  TIMSK1 = 0;
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TCNT1  = 0;
+  TIFR1  = _BV(TOV1);
+  TIMSK1 = _BV(TOIE1);
+
+  for (i=0; i<16; i++)
+    _bench_inputs[i] = 512;
+
+  _bench_inputs[CCHAN_SWITCH_FILTER]   = SWITCH_OFF;
+  _bench_inputs[CCHAN_SWITCH_WAVEFORM] = SWITCH_OFF;
+  _bench_inputs[CCHAN_SWITCH_RINGSYNC] = SWITCH_OFF;
+  _bench_inputs[CCHAN_CV]              = 300;
+  _bench_inputs[12]                    = 0; /* waveform CV below threshold */
+  _bench_inputs[14]                    = 0; /* ring/sync CV below threshold */
+  _bench_inputs[15]                    = 0; /* no unison spread */
+
+  /* Cost of an empty enter/leave pair, taken off every measurement */
+  bench_enter(BENCH_CYCLE);
+  bench_leave(BENCH_CYCLE);
+  _bench_overhead = _bench_cycles[BENCH_CYCLE];
+  _bench_cycles[BENCH_CYCLE] = 0;
+  _bench_calls[BENCH_CYCLE] = 0;
+}
+
+void
+bench_run()
+{
+  uint8_t  tick, id, s = 0;
+  uint16_t sp, cycle_bytes, isr_bytes;
+  uint32_t ms;
+
+#ifdef BENCH_SOUNDCHECK
+  /* One pass of the self test on its own timers, for the trace */
+  soundcheck_start(FALSE);
+  while (soundcheck_running())
+    uu_time_run();
+#elif defined(BENCH_WCET)
+  bench_wcet();
+#elif defined(BENCH_LATENCY)
+  bench_latency();
+#else
+  bench_puts_P(PSTR("bench,tick,function,cycles,calls\n"));
+  bench_puts_P(PSTR("stack,tick,context,bytes\n"));
+  bench_puts_P(PSTR("check,tick,what,ok\n"));
+
+  /* Everything so far, setup() included */
+  bench_stack_line(PSTR("boot"), 0, PSTR("all"), uu_stack_used());
+
+  for (tick = 0; tick < BENCH_TICKS; tick++)
+    {
+      while (s < BENCH_SCRIPT_N
+	     && pgm_read_byte(&bench_script[s].tick) == tick)
+	{
+	  _bench_inputs[pgm_read_byte(&bench_script[s].chan)]
+	    = pgm_read_word(&bench_script[s].value);
+	  s++;
+	}
+
+      if (tick == BENCH_SAMPLE_TICK)
+	sample_play(SAMPLE_KICK);
+
+      for (id = 0; id < BENCH_N; id++)
+	{
+	  _bench_cycles[id] = 0;
+	  _bench_calls[id] = 0;
+	}
+
+      sp = uu_stack_sp();
+      uu_stack_repaint();
+      cycle();
+      cycle_bytes = sp - uu_stack_low();
+
+      for (id = 0; id < BENCH_N; id++)
+	bench_line(tick, id);
+
+      /* Interrupts on their own, over an idle main loop */
+      sp = uu_stack_sp();
+      uu_stack_repaint();
+      ms = uu_time_ms();
+      while (uu_time_ms() - ms < BENCH_IDLE_MS)
+	;
+      isr_bytes = sp - uu_stack_low();
+
+      bench_stack_line(NULL, tick, PSTR("cycle"), cycle_bytes);
+      bench_stack_line(NULL, tick, PSTR("timer2_isr"), isr_bytes);
+      bench_check_pw(tick);
+    }
+#endif
+
+  /* simavr stops when sleeping with interrupts off */
+  cli();
+  sleep_enable();
+  sleep_cpu();
+}
@@ -0,0 +1,97 @@
+/*
+  'SID GUTS' firmware - cycle benchmark instrumentation
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_BENCH_H
+#define _HAVE_BENCH_H
+
+#include <stdint.h>
+
+/*
+ * Only built by 'make bench'. Firmware is run under simavr, Timer1 is
+ * taken over as a free running CPU cycle counter and the mux/ADC
+ * readings are replaced by a scripted input table. Results go out of
+ * the simavr console register as CSV lines prefixed with 'bench,'.
+ *
+ * Counts are inclusive, so cycle() includes everything it calls.
+ */
+
+#define BENCH_CYCLE       0
+#define BENCH_SID_POKE    1
+#define BENCH_LEDS        2
+#define BENCH_ANALOG_READ 3
+#define BENCH_SELECT_CHAN 4
+#define BENCH_TIMER2      5 /* sample/ramp/audio mod interrupt, its load */
+#define BENCH_CTL         6 /* control graph pass, without the panel scan */
+#define BENCH_N           7
+
+#define BENCH_TICKS       40
+
+/*
+ * 'make wcet' runs cycle() over an adversarial script then randomised
+ * panel input instead, keeping the slowest tick. EEPROM bytes a tick
+ * programs are charged at the datasheet 3.4ms each on top of what was
+ * measured, bus writes and _delay_us() are simulated cycles already.
+ */
+#ifndef BENCH_WCET_TICKS
+#define BENCH_WCET_TICKS  2000
+#endif
+#ifndef BENCH_WCET_SEED
+#define BENCH_WCET_SEED   0xace1
+#endif
+#ifndef BENCH_WCET_BUDGET
+#define BENCH_WCET_BUDGET (F_CPU / 50) /* the 20ms control tick */
+#endif
+#define BENCH_EEPROM_CYCLES ((uint32_t)F_CPU / 1000000 * 3400)
+
+/*
+ * 'make latency' steps the CV reading at random points in the tick
+ * period and times each step to SID registers 0/1, split by where the
+ * time went. Histogram bucket in us
+ */
+#ifndef BENCH_LATENCY_STEPS
+#define BENCH_LATENCY_STEPS  100
+#endif
+#ifndef BENCH_LATENCY_SEED
+#define BENCH_LATENCY_SEED   0x5eed
+#endif
+#define BENCH_LATENCY_BUCKET 1000
+#define BENCH_TICK_CYCLES    ((uint32_t)F_CPU / 50)
+
+#ifdef BENCH
+
+void bench_init();
+void bench_enter(uint8_t id);
+void bench_leave(uint8_t id);
+void bench_select_chan(int chan);
+int  bench_adc(int value);
+void bench_run();
+
+#define BENCH_ENTER(id) bench_enter(id)
+#define BENCH_LEAVE(id) bench_leave(id)
+
+#else
+
+#define BENCH_ENTER(id)
+#define BENCH_LEAVE(id)
+
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/*
+  'SID GUTS' firmware - control graph
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "bench.h"
+#include "sid.h"
+#include "ctl.h"
+#include <avr/pgmspace.h>
+
+Ctl _ctl;
+
+/* Run every node and resend the LEDs on the next tick, for after
+   something else has had the chip and panel */
+void
+ctl_reset ()
+{
+  _ctl.changed   = CTL_ALL;
+  _ctl.leds_sent = CTL_LEDS_STALE;
+}
+
+/* One pass over the node table, in PROGMEM */
+void
+ctl_run (const CtlNode *node, uint8_t n)
+{
+  CtlFn    fn;
+  uint16_t own, leds;
+#ifdef CTL_CHECK
+  uint32_t dirty;
+#endif
+
+  BENCH_ENTER(BENCH_CTL);
+
+  /* Straight through on a quiet panel */
+  for (; _ctl.changed && n; n--, node++)
+    {
+      if (!(pgm_read_dword(&node->in) & _ctl.changed))
+	continue;
+
+      fn  = (CtlFn)pgm_read_word(&node->fn);
+      own = pgm_read_word(&node->leds);
+#ifdef CTL_CHECK
+      dirty = _shadow.dirty;
+#endif
+
+      leds = fn();
+      _ctl.leds = (_ctl.leds & ~own) | (leds & own);
+
+#ifdef CTL_CHECK
+      _ctl.stray |= _shadow.dirty & ~dirty & ~pgm_read_dword(&node->regs);
+#endif
+    }
+
+  _ctl.changed = 0;
+
+  BENCH_LEAVE(BENCH_CTL);
+}
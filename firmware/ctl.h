@@ -0,0 +1,74 @@
+/*
+  'SID GUTS' firmware - control graph
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_CTL_H
+#define _HAVE_CTL_H
+
+#include <stdint.h>
+
+/*
+ * Control graph. Each tick the panel is scanned into input bits, set
+ * only for the inputs that changed. A node runs only when one of the
+ * bits it reads is set, and can raise further bits for the nodes after
+ * it, so the table has to be in dependency order. Nodes queue their
+ * SID writes with SID_set() and return their LED bits, the caller then
+ * flushes the merged dirty set and sends the LEDs once.
+ *
+ * A tick with nothing changed is a single test.
+ */
+
+typedef uint32_t CtlBits;
+typedef uint16_t (*CtlFn) ();
+
+typedef struct _CtlNode
+{
+  CtlBits  in;    /* bits that make it run */
+  uint32_t regs;  /* SID registers it queues, checked with CTL_CHECK */
+  uint16_t leds;  /* LED bits it owns */
+  CtlFn    fn;    /* returns its LED bits */
+} CtlNode;
+
+typedef struct _Ctl
+{
+  CtlBits  changed;
+  uint16_t leds;       /* merged from the nodes */
+  uint16_t leds_sent;
+#ifdef CTL_CHECK
+  uint32_t stray;      /* registers queued by a node that doesn't own them */
+#endif
+} Ctl;
+
+extern Ctl _ctl;
+
+#define CTL_ALL        0xffffffffUL
+#define CTL_REG(r)     (1UL << (r))
+#define CTL_LEDS_STALE 0xffff
+
+#define ctl_raise(bits) (_ctl.changed |= (bits))
+
+/* LEDs moved since they were last sent */
+#define ctl_leds_changed() (_ctl.leds != _ctl.leds_sent)
+#define ctl_leds_sent()    (_ctl.leds_sent = _ctl.leds)
+
+void ctl_reset ();
+void ctl_run (const CtlNode *nodes, uint8_t n);
+
+#endif
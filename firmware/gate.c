@@ -0,0 +1,93 @@
+/*
+  'SID GUTS' firmware - hard restart gate
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "sid.h"
+#include "gate.h"
+#include <util/atomic.h>
+
+GateVoice _gate[3];
+
+void gate_note_on (uint8_t v, uint8_t ctrl, uint8_t ad, uint8_t sr)
+{
+  uint16_t ticks = GATE_HR_SHORT_TICKS;
+
+#ifdef GATE_HR_US
+  uint8_t  base = v * SID_VOICE_2;
+
+  /* Rate counter can't be past 9 if every rate was already 0 */
+  if (gate_pending(v)
+      || _shadow.regs[base + SID_AD] != 0
+      || (_shadow.regs[base + SID_SR] & 0x0F) != 0)
+    ticks = GATE_HR_TICKS;
+#endif
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      _gate[v].ctrl  = ctrl & ~(GATE_ON|GATE_TEST);
+      _gate[v].ad    = ad;
+      _gate[v].sr    = sr;
+      _gate[v].start = TRUE;
+      _gate[v].ticks = ticks + 1; /* the restart takes a tick */
+    }
+}
+
+/* Cancels a restart still waiting, gate off with ctrl's waveform */
+void gate_note_off (uint8_t v, uint8_t ctrl)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      _gate[v].ticks = 0;
+      _gate[v].start = FALSE;
+    }
+
+  /* AD/SR stay zeroed if the restart had begun, the next note on
+     brings them back */
+  SID_poke(v * SID_VOICE_2 + SID_CTRL, ctrl & ~(GATE_ON|GATE_TEST));
+}
+
+/* From the Timer2 interrupt, before anything else */
+void gate_tick ()
+{
+  uint8_t v, base;
+
+  for (v = 0; v < 3; v++)
+    {
+      if (!_gate[v].ticks)
+	continue;
+
+      base = v * SID_VOICE_2;
+
+      if (_gate[v].start)
+	{
+	  _gate[v].start = FALSE;
+	  SID_poke_fast(base + SID_CTRL, _gate[v].ctrl | GATE_TEST);
+	  SID_poke_fast(base + SID_AD, 0);
+	  SID_poke_fast(base + SID_SR, 0);
+	}
+
+      if (--_gate[v].ticks == 0)
+	{
+	  SID_poke_fast(base + SID_AD, _gate[v].ad);
+	  SID_poke_fast(base + SID_SR, _gate[v].sr);
+	  SID_poke_fast(base + SID_CTRL, _gate[v].ctrl | GATE_ON);
+	}
+    }
+}
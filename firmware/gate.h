@@ -0,0 +1,80 @@
+/*
+  'SID GUTS' firmware - hard restart gate
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_GATE_H
+#define _HAVE_GATE_H
+
+#include <stdint.h>
+#include "sample.h"
+
+/*
+ * Hard restart note on. The Timer2 interrupt zeroes AD/SR and sets the
+ * test bit (rate period 9, oscillator held), waits a fixed time and
+ * then writes the real AD/SR and gate on together.
+ *
+ * The SID's envelope rate counter only resets when it hits the current
+ * rate period, so a gate on after a slower setting can wait up to 32768
+ * phi2 cycles before the attack starts. Waiting that out takes ~33ms,
+ * more than a 20ms control tick and audible when playing fast, so it is
+ * only done when built with GATE_HR_US (33000 covers a full wrap).
+ * Otherwise every restart is the short one.
+ *
+ * Both steps run on the Timer2 grid, first thing in the interrupt, so
+ * the attack starts a fixed GATE_HR_TICKS after the restart give or
+ * take interrupt latency (<= ~30us, the longest SID_poke()). The
+ * restart itself starts up to one tick (125us) after gate_note_on().
+ *
+ * Voices are 0..2.
+ */
+
+/* Note on to attack. With GATE_HR_US the long wait is only paid when
+   the voice's last AD/SR had a non zero rate or a restart was still
+   under way; the stock envelope has every rate 0 */
+#define GATE_HR_SHORT_US 1000
+
+#define GATE_HR_SHORT_TICKS ((uint32_t)GATE_HR_SHORT_US * SAMPLE_HZ / 1000000)
+#ifdef GATE_HR_US
+#define GATE_HR_TICKS       ((uint32_t)GATE_HR_US * SAMPLE_HZ / 1000000)
+#endif
+
+/* Control register bits */
+#define GATE_ON   0x01
+#define GATE_TEST 0x08
+
+typedef struct _GateVoice
+{
+  volatile uint16_t ticks; /* to gate on, 0 when idle */
+  volatile uint8_t  start; /* restart not yet written */
+  uint8_t           ctrl;  /* waveform etc, gate bit added */
+  uint8_t           ad;
+  uint8_t           sr;
+} GateVoice;
+
+extern GateVoice _gate[3];
+
+void gate_note_on (uint8_t v, uint8_t ctrl, uint8_t ad, uint8_t sr);
+void gate_note_off (uint8_t v, uint8_t ctrl);
+void gate_tick ();
+
+/* Restart under way, ctrl/AD/SR belong to the interrupt until done */
+#define gate_pending(v) (_gate[v].ticks != 0)
+
+#endif
@@ -0,0 +1,103 @@
+/*
+  'SID GUTS' firmware - control rate LFOs
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "lfo.h"
+
+/* First quarter of a sine, 0..127 */
+const uint8_t lfo_sine[64] PROGMEM = {
+  2, 5, 8, 11, 14, 17, 20, 23, 26, 29, 32, 35, 38, 41, 44, 47,
+  50, 53, 56, 58, 61, 64, 67, 69, 72, 74, 77, 79, 82, 84, 86, 89,
+  91, 93, 95, 97, 99, 101, 103, 105, 106, 108, 110, 111, 113, 114, 115, 117,
+  118, 119, 120, 121, 122, 123, 124, 124, 125, 125, 126, 126, 127, 127, 127, 127
+};
+
+static uint16_t _lfo_lfsr = 0xACE1;
+
+/* 16 bit galois LFSR, also used as a mod source */
+int8_t
+lfo_random ()
+{
+  _lfo_lfsr = (_lfo_lfsr >> 1) ^ (-(_lfo_lfsr & 1) & 0xB400);
+
+  return _lfo_lfsr;
+}
+
+void
+lfo_init (LFO *lfo, uint8_t shape, uint16_t rate, uint8_t depth)
+{
+  lfo->phase = 0;
+  lfo->rate  = rate;
+  lfo->shape = shape;
+  lfo->depth = depth;
+  lfo->out   = 0;
+  lfo->held  = lfo_random();
+}
+
+/* 10 bit pot to rate, 8 octaves from ~0.05Hz to ~12Hz at 50Hz ticks */
+uint16_t
+lfo_rate (int pot)
+{
+  uint8_t p = pot >> 2;
+
+  return (uint16_t)(32 + (p & 31)) << ((p >> 5) + 1);
+}
+
+int8_t
+lfo_update (LFO *lfo)
+{
+  uint16_t last = lfo->phase;
+  uint8_t  p, q;
+  int8_t   v;
+
+  lfo->phase += lfo->rate;
+  p = lfo->phase >> 8;
+
+  switch (lfo->shape)
+    {
+    case LFO_SINE:
+      q = p & 63;
+      if (p & 64)
+	q = 63 - q;
+      v = pgm_read_byte(&lfo_sine[q]);
+      if (p & 128)
+	v = -v;
+      break;
+    case LFO_TRI:
+      v = (p & 128) ? 127 - ((p & 127) << 1) : ((p & 127) << 1) - 128;
+      break;
+    case LFO_SAW:
+      v = p - 128;
+      break;
+    case LFO_SQUARE:
+      v = (p & 128) ? -128 : 127;
+      break;
+    case LFO_SH:
+    default:
+      if (lfo->phase < last) /* wrapped */
+	lfo->held = lfo_random();
+      v = lfo->held;
+      break;
+    }
+
+  lfo->out = v;
+
+  return v;
+}
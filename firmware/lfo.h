@@ -0,0 +1,59 @@
+/*
+  'SID GUTS' firmware - control rate LFOs
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_LFO_H
+#define _HAVE_LFO_H
+
+#include <stdint.h>
+#include "uu_fixmath.h"
+
+/*
+ * Phase accumulator LFOs run once per control tick. Phase is 0.16 of a
+ * cycle so at 50Hz a rate of r gives r * 50 / 65536 Hz. Output is
+ * signed 8 bit, scaled by an 8 bit depth with one MUL.
+ */
+
+#define LFO_SINE   0
+#define LFO_TRI    1
+#define LFO_SAW    2
+#define LFO_SQUARE 3
+#define LFO_SH     4 /* new random value each cycle */
+#define LFO_SHAPES 5
+
+typedef struct _LFO
+{
+  uint16_t phase;
+  uint16_t rate;   /* phase step per tick */
+  uint8_t  shape;
+  uint8_t  depth;
+  int8_t   out;
+  int8_t   held;   /* current S&H value */
+} LFO;
+
+void    lfo_init (LFO *lfo, uint8_t shape, uint16_t rate, uint8_t depth);
+uint16_t lfo_rate (int pot);
+int8_t  lfo_update (LFO *lfo);
+int8_t  lfo_random ();
+
+/* Output times depth, -32640..32385 */
+#define lfo_scaled(lfo) uu_mul_s8u8((lfo)->out, (lfo)->depth)
+
+#endif
@@ -20,8 +20,24 @@
   Boston, MA  02111-1307  USA
 */
 #include "uu.h"
+#include "uu_time.h"
+#include "uu_fixmath.h"
+#include "uu_keys.h"
+#include "uu_stack.h"
+#include "bench.h"
+#include "sid.h"
+#include "lfo.h"
+#include "mod.h"
+#include "ramp.h"
+#include "sample.h"
+#include "gate.h"
+#include "ctl.h"
+#include "quant.h"
 #include <avr/pgmspace.h>
 #include <util/delay.h>
+#include <util/atomic.h>
+#include <avr/sleep.h>
+#include <string.h>
 
 /* AVR Pins */
 #define PIN_MULT_IN PIN_C0 
@@ -51,6 +67,7 @@
 #define CCHAN_RINGSYNC 14 // to mod sel
 #define CCHAN_SWITCH_WAVEFORM 13
 #define CCHAN_WAVEFORM 12 
+#define CCHAN_SPARE 15
 
 /* LED Flags */
 #define LED_TRI   (1<<0)
@@ -90,6 +107,102 @@
 /* SID Realted */
 #define VOLUME 15
 #define CHAN3_OFF (1<<7)
+#define FILT_ROUTE (1|8) /* voice 1 and ext in through filter */
+#define FILT_VOICE_2 (1<<1)
+#define FILT_VOICE_3 (1<<2)
+#define ENV_AD 0x00 /* Fast Attack, Decay */
+#define ENV_SR 0xF0 /* Full volume on sustain, quick release */
+
+/* Unison */
+#define UNISON_DETUNE_SHIFT 14 /* spread of 255 is ~1.5% either side */
+
+/* Owners of the spare mux inputs, CCHAN_NONE (8) and CCHAN_SPARE (15).
+   One setting for both, saved with the unison byte and stepped by the
+   waveform+filter chord while tuning. Anything not the owner reads 0,
+   or keeps its last value */
+#define SPARES_DETUNE 0 /* 8 mod source SPARE_1, 15 unison spread */
+#define SPARES_MOD    1 /* 8 and 15 mod sources SPARE_1 and SPARE_2 */
+#define SPARES_LFO    2 /* by _lfo_panel, LFO 1 rate and depth */
+#define SPARES_AMOD   3 /* 8 audio rate mod rate, 15 its depth */
+
+/* Tuning, a held switch repeats faster and faster, and every 4th
+   repeat also steps one more table entry */
+#define TUNE_ACCEL_SHIFT 2
+#define TUNE_STEP_MAX    8
+
+/* Control tick and the faster cutoff/pulse width ramp tick, divided
+   down from the Timer2 sample rate */
+#define TICK_HZ    50
+#define RAMP_HZ    1000
+#define RAMP_STEPS (RAMP_HZ / TICK_HZ) /* one control period per ramp */
+#define RAMP_DIV   (SAMPLE_HZ / RAMP_HZ)
+
+/* SID start up. Registers are only sent once the chip has had time to
+   settle, then resent a couple of times for SwinSIDs that miss early
+   writes. 20ms is plenty for a real 6581/8580 and its power rails; a
+   SwinSID that boots slowly may want -DSID_SETTLE_MS=2000 */
+#ifndef SID_SETTLE_MS
+#define SID_SETTLE_MS 20
+#endif
+#define SID_RESENDS   2
+#define SID_RESEND_MS 250
+
+/* Registers rewritten per tick in the background, a pass takes 25 ticks
+   (0.5s) per chip at 1 */
+#ifndef SID_REFRESH_PER_TICK
+#define SID_REFRESH_PER_TICK 1
+#endif
+
+/* Stack high water mark, rescanned this often into _stack_used */
+#define STACK_SCAN_MS 1000
+
+/* Pitch CV snapped to a scale, QUANT_OFF plays it as read (quant.h) */
+#ifndef CV_QUANT
+#define CV_QUANT QUANT_OFF
+#endif
+
+/* Kick sample trigger, off in a stock build: every mux input already
+   has an owner, the spares included. Build with SAMPLE_TRIG_CHAN set to
+   a mux channel wired to a gate to fire it on a rising edge; a spare
+   input used this way must be kept off the spares setting that reads it.
+   The bench run still plays it */
+
+/* Audio rate modulation of cutoff or pulse width from Timer2, rate and
+   depth on the spare mux inputs while they are SPARES_AMOD. AMOD_DIV 1,
+   2 or 4 runs it at 8, 4 or 2kHz */
+#define AMOD_OFF        0
+#define AMOD_CUTOFF     1
+#define AMOD_PW         2
+#ifndef AMOD_DST
+#define AMOD_DST        AMOD_OFF
+#endif
+#ifndef AMOD_DIV
+#define AMOD_DIV        2
+#endif
+#define AMOD_RATE_CHAN  CCHAN_NONE
+#define AMOD_DEPTH_CHAN CCHAN_SPARE
+#define AMOD_RATE_SHIFT 5 /* full pot is just under half the step rate */
+
+#if AMOD_DST != AMOD_OFF
+#define SPARES_N        4
+#else
+#define SPARES_N        3
+#endif
+
+/* LFOs, routed by the mod matrix */
+#define LFO_1    0
+#define LFO_2    1
+#define LFO_3    2 /* S&H, the random mod source */
+#define LFO_N    3
+#define LFO_CHAN_STORED 0xff /* no panel input, keep the stored value */
+
+/* Mod matrix output scaling, a full depth slot on a full scale source
+   moves ~3.7 semitones, ~half the pulse width or cutoff range, or ~all
+   of the resonance */
+#define MOD_FREQ_SHIFT 1  /* right shift, volts_to_freq steps */
+#define MOD_PW_SHIFT   4  /* left shifts */
+#define MOD_CUT_SHIFT  3
+#define MOD_RES_SHIFT  3  /* right shift */
 
 /* Freq LUT */
 #define VOLTS_FREQ_MIN 1304
@@ -321,19 +434,114 @@ typedef struct _SIDState
   uint8_t  hp,bp,lp;
   uint8_t  chan_3_state;
   bool     gate_off;
+  bool     unison;
+  int      detune;
+  uint8_t  spares;       /* SPARES_* */
 } SIDstate;
 
+/* Which mux inputs, if any, set each LFO's rate and depth while the
+   spares are SPARES_LFO */
+typedef struct _LFOPanel
+{
+  uint8_t  rate_chan;
+  uint8_t  depth_chan;
+} LFOpanel;
+
 SIDstate _sid;
+Ramp     _ramp_pw, _ramp_cutoff;
+uint8_t  _ramp_pw_voices = 1; /* bit per voice sharing the pulse width */
+volatile bool _tick = FALSE;
+volatile uint8_t _sample_mode = CHAN3_OFF; /* reg 24 top bits for samples */
+#if AMOD_DST != AMOD_OFF
+LFO      _amod;
+int16_t  _amod_centre; /* reg 22, or the 12 bit pulse width */
+#endif
+LFO      _lfo[LFO_N];
+LFOpanel _lfo_panel[LFO_N] = {
+  { CCHAN_NONE,      CCHAN_SPARE },     /* LFO_1  */
+  { LFO_CHAN_STORED, LFO_CHAN_STORED }, /* LFO_2  */
+  { LFO_CHAN_STORED, LFO_CHAN_STORED }, /* LFO_3  */
+};
 int16_t _tune_offset = VOLTS_FREQ_INIT_OFF;
+UUtimer  _sid_boot;
+uint8_t  _sid_boot_resends = SID_RESENDS;
+UUkeys   _keys;
+Quant    _quant;
+UUtimer  _stack_scan;
+uint16_t _stack_used; /* deepest stack seen, bytes, for a debugger */
+
+/* Control graph inputs, set by the panel scan when a reading moves */
+#define IN_SWITCH   (1UL<<0)  /* switch events queued */
+#define IN_WAVE_CV  (1UL<<1)
+#define IN_DETUNE   (1UL<<2)
+#define IN_CV       (1UL<<3)
+#define IN_PWM      (1UL<<4)
+#define IN_FILT     (1UL<<5)
+#define IN_RES      (1UL<<6)
+#define IN_RINGSYNC (1UL<<7)
+#define IN_RS_CV    (1UL<<8)
+#define IN_MOD      (1UL<<9)  /* a mod matrix output moved */
+
+/* and raised by nodes for the ones after them */
+#define SIG_TUNE    (1UL<<16) /* tuning mode or offset */
+#define SIG_WAVE    (1UL<<17) /* waveform switch, gate off/on */
+#define SIG_FILTER  (1UL<<18) /* filter type */
+#define SIG_STATE   (1UL<<19) /* osc 3 ring/sync state */
+#define SIG_CTRL    (1UL<<20) /* voice 1 control register to resync */
+#define SIG_VOICE   (1UL<<21) /* voice 1 setup the unison voices copy */
+#define SIG_UNISON  (1UL<<22)
+#define SIG_ROUTE   (1UL<<23) /* filter routing, mode or resonance */
+
+#define CTL_VOICE_REGS(v) (CTL_REG((v) + SID_FREQ_LO) | CTL_REG((v) + SID_FREQ_HI) \
+			   | CTL_REG((v) + SID_CTRL) | CTL_REG((v) + SID_AD) \
+			   | CTL_REG((v) + SID_SR))
+
+/* Last panel readings, and what the nodes pass on within a tick */
+typedef struct _Panel
+{
+  bool     want_tune;
+  bool     save;          /* settings changed, written once let go */
+  bool     last_gate;
+  bool     pending;       /* a hard restart was running */
+  bool     playing;       /* a sample was */
+  uint8_t  state;         /* osc 3 state wanted, _sid has the one set */
+  uint8_t  filter_mask;   /* reg 24 */
+  uint8_t  route;         /* unison voices through the filter */
+  int      wave_cv, detune, cv, pwm, filt, res, ringsync, rs_cv;
+  int16_t  mod[MOD_DST_N];
+
+  /* this tick only */
+  bool     step_wave;
+  bool     sync_waveform;
+  bool     reset_osc1;
+  bool     restart;
+} Panel;
+
+Panel _panel;
+
+/* Switch gestures, for the modes they apply in */
+#define GESTURE_PLAY 1
+#define GESTURE_TUNE 2 /* tuning, the switches step the offset */
+#define GESTURE_ANY  (GESTURE_PLAY|GESTURE_TUNE)
+
+typedef struct _Gesture
+{
+  uint8_t event;   /* UU_KEY_* */
+  uint8_t keys;    /* switch or exact chord */
+  uint8_t when;
+  void  (*fn) (uint8_t n);
+} Gesture;
+
+#define panel_sync() (_panel.sync_waveform = TRUE, ctl_raise(SIG_CTRL))
 
 void cycle ();
 
+/* Interrupts stay on while the EEPROM is busy, ~3.4ms a byte that
+   changed. avr-libc holds them off for the timed write strobe itself */
 void 
 tuning_save()
 {
-  uu_interrupts_off();
-  eeprom_write_word (1, _tune_offset);
-  uu_interrupts_on();
+  eeprom_update_word (1, _tune_offset);
 }
 
 void
@@ -347,9 +555,8 @@ settings_save()
     |(_sid.filter_type<<2)  /* Filter 4-2  */
     |_sid.chan_3_state;	    /* State  2-1  */
 
-  uu_interrupts_off();
-  eeprom_write_byte (0, b);
-  uu_interrupts_on();
+  eeprom_update_byte (0, b);
+  eeprom_update_byte (3, _sid.unison | (_sid.spares << 4));
 }
 
 void
@@ -371,6 +578,14 @@ settings_load()
 
   _tune_offset = eeprom_read_word (1);
 
+  b = eeprom_read_byte (3);
+  if (b == 0xff) /* saved before unison */
+    b = 0;
+  _sid.unison = b & 1;
+  _sid.spares = b >> 4;
+  if (_sid.spares >= SPARES_N)
+    _sid.spares = SPARES_DETUNE;
+
   /* Safety on */
   if (_tune_offset < VOLTS_FREQ_MIN_OFF)
     _tune_offset = VOLTS_FREQ_MIN_OFF;
@@ -396,6 +611,8 @@ void leds_set_mask(uint32_t mask)
 {
   byte shift_mask = mask & 0xFF;
 
+  BENCH_ENTER(BENCH_LEDS);
+
   if (mask & LED_SYNC)
     uu_pin_digital_write(PIN_LED_I, HIGH);
   else
@@ -404,29 +621,53 @@ void leds_set_mask(uint32_t mask)
   uu_pin_digital_write(PIN_LED_ENABLE, LOW);
   uu_pin_shift_out(PIN_LED_DATA, PIN_LED_CLOCK, MSBFIRST, shift_mask);  
   uu_pin_digital_write(PIN_LED_ENABLE, HIGH);
+
+  BENCH_LEAVE(BENCH_LEDS);
 }
 
 int analog_read()
 {
   uint8_t low, high;
-  
+
+  BENCH_ENTER(BENCH_ANALOG_READ);
+
   /* switch to ADMUX for (1<<6) - AVcc with external capacitor on AREF pin  */
   ADMUX |= 0; // AREF, Internal Vref turned off  & chan 0 
   
-  ADCSRA = (1<<ADEN) | (1<<ADPS2) | (1<<ADPS1);
+  ADCSRA = (1<<ADEN) | (1<<ADIE) | (1<<ADPS2) | (1<<ADPS1);
   /* Start conversion */
   ADCSRA |= (1<<ADSC);
-  /* Wait.. */
-  while (uu_bit_is_set(ADCSRA, ADSC));
+  /* Wait with the CPU clock stopped, woken by ADC complete or a timer,
+     rather than spinning on ADSC. Any effect on reading noise is not
+     measured. Not ADC noise reduction sleep, that stops Timer0 and the
+     SID clock */
+  cli();
+  while (uu_bit_is_set(ADCSRA, ADSC))
+    {
+      sleep_enable();
+      sei();
+      sleep_cpu();
+      sleep_disable();
+      cli();
+    }
+  sei();
   /* Collect */
   low  = ADCL;
   high = ADCH;
 
+  BENCH_LEAVE(BENCH_ANALOG_READ);
+
+#ifdef BENCH
+  return bench_adc((high << 8) | low);
+#endif
+
   return (high << 8) | low;
 }
 
 void select_chan(int chan)
 {
+  BENCH_ENTER(BENCH_SELECT_CHAN);
+
   uu_pin_digital_write (PIN_MULT_A, (chan & 0x01));
   uu_pin_digital_write (PIN_MULT_B, ((chan >> 1) & 0x01));
   uu_pin_digital_write (PIN_MULT_C, ((chan >> 2) & 0x01));
@@ -443,6 +684,12 @@ void select_chan(int chan)
    */
 
   _delay_us(500);
+
+#ifdef BENCH
+  bench_select_chan(chan);
+#endif
+
+  BENCH_LEAVE(BENCH_SELECT_CHAN);
 }
 
 int read_chan_analog(int chan)
@@ -476,114 +723,300 @@ byte switches_read_mask()
 }
 
 
-void SID_poke (uint8_t port, uint8_t data) 
+void lfo_tick ()
 {
-  PORTB = (port & 0x0F) | 0x10;        // Lower bit, keep CS deactive
-  PORTD = ((port | 0x20) & 0xF0) >> 2; // Upper bit, reset high
-  PORTD |= 0x80;                       // Clock in Address
-  _delay_us(10);
-  PORTD &= ~(0x80);
-
-  PORTB = (data & 0x0F) | 0x10;  // Lower bit, keep CS deactive
-  PORTD = (data & 0xF0) >> 2;    // Upper bit
-  PORTB &= ~(0x10);   // Activate /CS
-  _delay_us(10);
-  PORTB |= 0x10;      // Deactivate /CS
-}  
-
-void soundcheck()
+  uint8_t n;
+  bool    panel = (_sid.spares == SPARES_LFO);
+
+  for (n = 0; n < LFO_N; n++)
+    {
+      if (panel && _lfo_panel[n].rate_chan != LFO_CHAN_STORED)
+	_lfo[n].rate = lfo_rate(read_chan_analog(_lfo_panel[n].rate_chan));
+
+      if (panel && _lfo_panel[n].depth_chan != LFO_CHAN_STORED)
+	_lfo[n].depth = read_chan_analog(_lfo_panel[n].depth_chan) >> 2;
+
+      lfo_update(&_lfo[n]);
+    }
+}
+
+/* Gather mod sources and run the matrix, cv is this tick's pitch reading */
+void mod_tick (int cv)
 {
-  int waveforms[] = { WAVEFORM_PULSE, WAVEFORM_SAW, WAVEFORM_TRI, WAVEFORM_NOISE };
-  int filters[] = { FILTER_LP, FILTER_BP, FILTER_HP, FILTER_NOTCH };
-  int i,j, k;
+  uint8_t used = mod_sources_used();
+
+  _mod_src[MOD_SRC_CV] = mod_from_pot(cv);
+
+  /* Spare inputs cost a mux settle, only read them if routed, and
+     they are silent while something else owns them */
+  _mod_src[MOD_SRC_SPARE_1] = 0;
+  _mod_src[MOD_SRC_SPARE_2] = 0;
+  if ((used & _BV(MOD_SRC_SPARE_1)) && _sid.spares != SPARES_AMOD)
+    _mod_src[MOD_SRC_SPARE_1] = mod_from_pot(read_chan_analog(CCHAN_NONE));
+  if ((used & _BV(MOD_SRC_SPARE_2)) && _sid.spares == SPARES_MOD)
+    _mod_src[MOD_SRC_SPARE_2] = mod_from_pot(read_chan_analog(CCHAN_SPARE));
+
+  _mod_src[MOD_SRC_LFO_1]  = lfo_scaled(&_lfo[LFO_1]) >> 8;
+  _mod_src[MOD_SRC_LFO_2]  = lfo_scaled(&_lfo[LFO_2]) >> 8;
+  _mod_src[MOD_SRC_RANDOM] = lfo_scaled(&_lfo[LFO_3]) >> 8;
+
+#ifdef SID_READBACK
+  /* Voice 3 as a hardware LFO/envelope, one bus read a tick taking
+     OSC3 and ENV3 in turn */
+  if (used & (_BV(MOD_SRC_OSC3)|_BV(MOD_SRC_ENV3)))
+    {
+      static bool env = FALSE;
 
-  /* Test Waveforms */
-  for (k=0;k<1;k++)
+      if (env)
+	_mod_src[MOD_SRC_ENV3] = SID_peek(SID_ENV3) >> 1;
+      else
+	_mod_src[MOD_SRC_OSC3] = SID_peek(SID_OSC3) - 128;
+
+      env = !env;
+    }
+#endif
+
+  mod_eval();
+}
+
+/* Pitch from the CV table, moved by a mod matrix output */
+unsigned int mod_freq (int idx, int16_t mod)
+{
+  idx += mod >> MOD_FREQ_SHIFT;
+
+  if (idx < 0) idx = 0;
+  if (idx > VOLTS_FREQ_N - 1) idx = VOLTS_FREQ_N - 1;
+
+  return pgm_read_word(&volts_to_freq[idx]);
+}
+
+/* Copy voice 1 setup onto another voice, at a detuned frequency. With
+   restart it follows voice 1's hard restart */
+void unison_voice (uint8_t voice, unsigned int f, uint8_t ctrl, bool restart)
+{
+  uint8_t v = voice / SID_VOICE_2;
+
+  SID_set(voice + 0, f);
+  SID_set(voice + 1, f>>8);
+
+  if (restart)
+    gate_note_on(v, ctrl, ENV_AD, ENV_SR);
+  if (gate_pending(v))
+    return; /* gate and envelope are the restart's until it is done */
+
+  SID_set(voice + 4, ctrl);
+  /* Voice 1's envelope, not its registers, which its own restart may
+     still have zeroed */
+  SID_set(voice + 5, ENV_AD);
+  SID_set(voice + 6, _sid.gate_off ? 0x00 : ENV_SR);
+}
+
+/* Voices sharing the pulse width ramp. The interrupt only writes them
+   when the ramp moves, so one joining starts at the ramp's value now
+   rather than whatever it last had, 0 after boot */
+void ramp_pw_join (uint8_t voices)
+{
+  uint8_t  v, joined;
+  uint16_t i;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-      unsigned int n,f,d,e;
+      joined = voices & ~_ramp_pw_voices;
+      _ramp_pw_voices = voices;
+      i = ramp_value(&_ramp_pw);
 
-      SID_poke(4,WAVEFORM_PULSE|(0<<2)|(0<<1)|1);
+      for (v = 0; v < 3; v++)
+	if (joined & (1<<v))
+	  {
+	    SID_poke_fast(v * SID_VOICE_2 + 2, uu_bit_low_byte(i));
+	    SID_poke_fast(v * SID_VOICE_2 + 3, uu_bit_high_byte(i));
+	  }
+    }
+}
 
-      /* Set pulse width middle */
-      SID_poke(2,uu_bit_low_byte(2056));
-      SID_poke(3,uu_bit_high_byte(206));
+/* Timer callback, the chip has settled so the register image goes out */
+void sid_boot (void *arg)
+{
+  SID_replay();
 
-      /* low pass */
-      SID_poke(24, (CHAN3_OFF|(0<<6)|(0<<5)|(1<<4)|VOLUME));
+  if (_sid_boot_resends)
+    {
+      _sid_boot_resends--;
+      uu_timer_start(&_sid_boot, SID_RESEND_MS, sid_boot, NULL);
+    }
+}
+
+/* Timer callback, the scan is too slow to do every tick */
+void stack_scan (void *arg)
+{
+  _stack_used = uu_stack_used();
+  uu_timer_start(&_stack_scan, STACK_SCAN_MS, stack_scan, NULL);
+}
+
+/* Self test, a table of steps run from a uu_time timer so inputs and
+   LEDs stay live and any switch press stops it. Each waveform plays a
+   pitch ladder over the whole CV range, then noise goes through each
+   filter mode with a cutoff sweep */
+#define CHECK_WAVE     0 /* value is the waveform, sub steps are notes */
+#define CHECK_FILTER   1 /* value is reg 24, sub steps are cutoffs */
+#define CHECK_NOTES    12
+#define CHECK_NOTE_MS  650
+#define CHECK_SWEEP    1024
+#define CHECK_SWEEP_MS 10
+#define CHECK_WAIT_MS  10 /* polling for the chip at boot */
+#define CHECK_NOISE_F  0x9999
+
+typedef struct _CheckStep
+{
+  uint8_t kind;
+  uint8_t value;
+  int     leds;
+} CheckStep;
+
+const CheckStep check_steps[] PROGMEM = {
+  { CHECK_WAVE,   WAVEFORM_PULSE, LED_PULSE },
+  { CHECK_WAVE,   WAVEFORM_SAW,   LED_SAW },
+  { CHECK_WAVE,   WAVEFORM_TRI,   LED_TRI },
+  { CHECK_WAVE,   WAVEFORM_NOISE, LED_NOISE },
+  { CHECK_FILTER, (CHAN3_OFF|(0<<6)|(0<<5)|(1<<4)|VOLUME), LED_LO },
+  { CHECK_FILTER, (CHAN3_OFF|(0<<6)|(1<<5)|(0<<4)|VOLUME), LED_MID },
+  { CHECK_FILTER, (CHAN3_OFF|(1<<6)|(0<<5)|(0<<4)|VOLUME), LED_HI },
+  { CHECK_FILTER, (CHAN3_OFF|(1<<6)|(0<<5)|(1<<4)|VOLUME), LED_LO|LED_HI },
+};
+
+#define CHECK_STEPS (sizeof(check_steps)/sizeof(CheckStep))
+
+typedef struct _Check
+{
+  bool     running;
+  bool     repeat;
+  uint8_t  step;
+  uint16_t sub;
+  uint8_t  image[SID_REGS];     /* put back afterwards */
+  UUtimer  timer;
+} Check;
+
+Check _check;
+
+void soundcheck_stop ()
+{
+  uu_timer_cancel(&_check.timer);
+  _check.running = FALSE;
+
+  memcpy(_shadow.regs, _check.image, SID_REGS);
+  SID_replay();
+  ctl_reset(); /* LEDs were the test's */
+}
+
+void soundcheck_done (void *arg)
+{
+  soundcheck_stop();
+}
+
+void soundcheck_step (void *arg)
+{
+  CheckStep    s;
+  unsigned int f;
+  uint16_t     n, ms;
+
+  if (_sid_held) /* chip not settled yet */
+    {
+      uu_timer_start(&_check.timer, CHECK_WAIT_MS, soundcheck_step, NULL);
+      return;
+    }
 
-      /* resonance */
-      SID_poke(23,(8<<4)|9 /* 9 may be safer */);
+  memcpy_P(&s, &check_steps[_check.step], sizeof(s));
+
+  if (_check.step == 0 && _check.sub == 0)
+    {
+      /* Pulse width middle, low pass with some resonance */
+      SID_poke(2, uu_bit_low_byte(2048));
+      SID_poke(3, uu_bit_high_byte(2048));
+      SID_poke(23, (8<<4)|9 /* 9 may be safer */);
       f = 1024 << 1;
-      SID_poke(21,uu_bit_low_byte(f));     // Set filter value - 11bits
+      SID_poke(21, uu_bit_low_byte(f) & 7); // Set filter value - 11bits
       SID_poke(22, uu_bit_high_byte(f << 5));
+      SID_poke(24, (CHAN3_OFF|(0<<6)|(0<<5)|(1<<4)|VOLUME));
+    }
 
-      for (j=0;j<4;j++)
+  if (_check.sub == 0)
+    {
+      leds_set_mask(s.leds);
+
+      if (s.kind == CHECK_FILTER)
 	{
-	  switch (waveforms[j])
-	    {
-	    case WAVEFORM_TRI:
-	      leds_set_mask(LED_TRI);
-	      break;
-	    case WAVEFORM_SAW:
-	      leds_set_mask(LED_SAW);
-	      break;
-	    case WAVEFORM_NOISE:
-	      leds_set_mask(LED_NOISE);
-	      break;
-	    case WAVEFORM_PULSE:
-	      leds_set_mask(LED_PULSE);
-	      break;
-	    }
+	  SID_poke(4, WAVEFORM_NOISE|1);
+	  SID_poke(0, CHECK_NOISE_F);
+	  SID_poke(1, CHECK_NOISE_F>>8);
+	  SID_poke(24, s.value);
+	}
+    }
 
-	  for(i=0;i<12;i++) 
-	    {
-	      f = pgm_read_word(&volts_to_freq[(1024/12)*i]);
+  if (s.kind == CHECK_WAVE)
+    {
+      f = pgm_read_word(&volts_to_freq[(uint32_t)(VOLTS_FREQ_N - 1)
+				       * _check.sub / (CHECK_NOTES - 1)]);
+      SID_poke(4, s.value|1);
+      SID_poke(0, f);
+      SID_poke(1, f>>8);
+      n  = CHECK_NOTES;
+      ms = CHECK_NOTE_MS;
+    }
+  else
+    {
+      f = _check.sub << 1;
+      SID_poke(21, uu_bit_low_byte(f) & 7);
+      SID_poke(22, uu_bit_high_byte(f << 5));
+      n  = CHECK_SWEEP;
+      ms = CHECK_SWEEP_MS;
+    }
 
-	      SID_poke(4,waveforms[j]|(0<<2)|(0<<1)|1);
-	      SID_poke(0,f);   // Send frequency to chanel
-	      SID_poke(1,f>>8);
-	      for(d=0;d<65000;d++)   
-		_delay_us(10);
+  if (++_check.sub >= n)
+    {
+      _check.sub = 0;
+      if (++_check.step >= CHECK_STEPS)
+	{
+	  _check.step = 0;
+	  if (!_check.repeat)
+	    {
+	      uu_timer_start(&_check.timer, ms, soundcheck_done, NULL);
+	      return;
 	    }
 	}
     }
 
-  /* SWEEP NOISE */
-  SID_poke(4,WAVEFORM_NOISE|(0<<2)|(0<<1)|1);
-  SID_poke(0, 0x9999);
-  SID_poke(1, 0x9999>>8);
+  uu_timer_start(&_check.timer, ms, soundcheck_step, NULL);
+}
 
-  for (k=0;k<1;k++)
-    for (j=0;j<4;j++)
-      {
-	switch (filters[j])
-	  {
-	  case FILTER_NOTCH:
-	    SID_poke(24, (CHAN3_OFF|(1<<6)|(0<<5)|(1<<4)|VOLUME));
-	    leds_set_mask(LED_LO|LED_HI);
-	    break;
-	  case FILTER_HP:
-	    SID_poke(24, (CHAN3_OFF|(1<<6)|(0<<5)|(0<<4)|VOLUME));
-	    leds_set_mask(LED_HI);
-	    break;
-	  case FILTER_LP:
-	    SID_poke(24, (CHAN3_OFF|(0<<6)|(0<<5)|(1<<4)|VOLUME));
-	    leds_set_mask(LED_LO);
-	    break;
-	  case FILTER_BP:
-	    SID_poke(24, (CHAN3_OFF|(0<<6)|(1<<5)|(0<<4)|VOLUME));
-	    leds_set_mask(LED_MID);
-	    break;
-	  }
-	
-	for (i=0;i<1024;i++)
-	  {
-	    int f = i << 1;
-	    SID_poke(21,uu_bit_low_byte(f));     // Set filter value - 11bits
-	    SID_poke(22, uu_bit_high_byte(f << 5));
-	    _delay_us(10000);
-	  }
-      }
+void soundcheck_start (bool repeat)
+{
+  memcpy(_check.image, _shadow.regs, SID_REGS);
+
+  _check.running  = TRUE;
+  _check.repeat   = repeat;
+  _check.step     = 0;
+  _check.sub      = 0;
+
+  uu_timer_start(&_check.timer, 0, soundcheck_step, NULL);
+}
+
+bool soundcheck_running ()
+{
+  return _check.running;
+}
+
+/* In place of cycle() while the test runs, any press stops it and is
+   used up doing so */
+void soundcheck_tick ()
+{
+  UUkeyEvent e;
+
+  uu_keys_scan(&_keys, switches_read_mask(), uu_time_ms());
+
+  while (uu_keys_event(&_keys, &e))
+    if ((e.type == UU_KEY_PRESS || e.type == UU_KEY_CHORD)
+	&& _check.running)
+      soundcheck_stop();
 }
 
 void setup () 
@@ -600,6 +1033,13 @@ void setup ()
   uu_pin_mode(PIN_LED_I, OUTPUT);
 
   uu_pin_mode(PIN_MULT_IN, INPUT);
+  DIDR0 = (1<<ADC0D); /* analog only, no digital input buffer on the mux */
+
+  /* Nothing uses TWI, SPI or the USART */
+  PRR = (1<<PRTWI) | (1<<PRSPI) | (1<<PRUSART0);
+
+  /* Idle between ticks and during conversions, timers keep running */
+  set_sleep_mode(SLEEP_MODE_IDLE);
 
   uu_pin_mode(PIN_MULT_A, OUTPUT);
   uu_pin_mode(PIN_MULT_B, OUTPUT);
@@ -628,12 +1068,35 @@ void setup ()
   _sid.hp = _sid.bp = 0; _sid.lp = 1;
   _sid.chan_3_state = STATE_NONE;
   _sid.gate_off = FALSE;
+  _sid.unison = FALSE;
+  _sid.detune = 0;
+  _sid.spares = SPARES_DETUNE;
+
+  /* Full depth here, the mod slots say how much goes where. LFO 1 is
+     silent until the spare inputs give it a depth */
+  lfo_init(&_lfo[LFO_1], LFO_TRI, lfo_rate(300), 0);
+  lfo_init(&_lfo[LFO_2], LFO_SINE, lfo_rate(200), 255);
+  lfo_init(&_lfo[LFO_3], LFO_SH, lfo_rate(500), 255);
+  mod_init();
+#if AMOD_DST != AMOD_OFF
+  lfo_init(&_amod, LFO_SINE, 0, 0);
+#endif
 
   settings_load();
+  quant_init(&_quant, CV_QUANT);
 
-  /* Give swinsid a chance to initialise... seems racey, not sure why */
-  for (i=0;i<2000;i++)
-    _delay_us(1000);
+  /* First tick runs the whole control graph */
+  _panel.state = _sid.chan_3_state;
+  panel_sync();
+  ctl_reset();
+
+  /* Build the register image now, sid_boot() sends it once the chip has
+     settled. Input scanning starts straight away */
+  SID_hold();
+
+#if SID_CHIPS > 1
+  SID_mode(SID_DUAL_MODE);
+#endif
 
   /* Clear all regs */
   for(c=0; c<25;c++)
@@ -641,8 +1104,8 @@ void setup ()
 
   /* Write some default values to the SID */
   SID_poke(24,15);    /* Turn up the volume */
-  SID_poke(5,0);      /* Fast Attack, Decay */
-  SID_poke(6,0xF0);   /* Full volume on sustain, quick release */
+  SID_poke(5,ENV_AD);
+  SID_poke(6,ENV_SR);
   SID_poke(4,0x21);   /* Enable gate, sawtooth waveform. */
 
   leds_set_mask(0);
@@ -653,171 +1116,419 @@ void setup ()
       i++;
       if (i > 1000)
 	{
-	  while (1)
-	    soundcheck();
-	  SID_poke(4,0x21); 
+	  soundcheck_start(TRUE); /* until a switch is pressed */
+	  break;
 	}
     }
 
+  /* Still held from the above isn't a press */
+  uu_keys_init(&_keys, switches_read_mask());
+
+  /* Timer 2 plays samples at 8kHz and steps the ramps every 8th */
+  TCCR2A = _BV(WGM21);                            /* CTC */
+  TCCR2B = _BV(CS21);                             /* clock / 8 */
+  OCR2A  = (F_CPU / 8 / SAMPLE_HZ) - 1;
+  TIMSK2 = _BV(OCIE2A);
+
+#ifndef BENCH /* Timer 1 is the cycle counter there */
   /* set up Timer 1 for processing input & output at 50hz (like real SID to avoid excessive noise) */
   TCCR1A = 0;                                     /* normal operation */
   TCCR1B = _BV(WGM12) | _BV(CS10) | _BV (CS12);   /* CTC, scale to clock / 1024 */
   OCR1A =  319;                                   /* compare A register value (319 * clock speed / 1024) = 50hz / 20ms */
   TIMSK1 = _BV (OCIE1A);                          /* interrupt on Compare A Match */
+
+  uu_timer_start(&_sid_boot, SID_SETTLE_MS, sid_boot, NULL);
+  uu_timer_start(&_stack_scan, STACK_SCAN_MS, stack_scan, NULL);
+#else
+  SID_replay(); /* no main loop to run timers */
+#endif
 }
 
-void cycle () 
+
+static void panel_read (int *last, CtlBits bit, uint8_t chan)
 {
-  static bool last_gate = 0;
-  static byte switch_ignore_mask = 0;
-  static bool want_tune = FALSE;
-  static bool first_run = TRUE;
+  int i = read_chan_analog(chan);
 
-  unsigned int f;
-  uint8_t      c;
-  int          i, waveform, state;
-  bool         sync_waveform = FALSE, sync_filter = FALSE, reset_osc1 = FALSE;
+  if (i != *last)
+    {
+      *last = i;
+      ctl_raise(bit);
+    }
+}
 
-  uint8_t      filter_mask = 0;
-  int          led_mask    = 0;
-  byte         switch_mask = 0;
+/* Through the quantiser, only a new note moves the pitch */
+static void panel_read_cv ()
+{
+  int i = quant_cv(&_quant, read_chan_analog(CCHAN_CV));
 
-#define CHECK_SWITCH(key) \
-        (switch_mask & (key) && !(switch_ignore_mask & (key)))
+  if (i != _panel.cv)
+    {
+      _panel.cv = i;
+      ctl_raise(IN_CV);
+    }
+}
 
-  switch_mask = switches_read_mask();
+/* Read everything, noting what moved. Pots only needed in some modes
+   are skipped otherwise, each costs a mux settle */
+void panel_scan ()
+{
+#ifdef SAMPLE_TRIG_CHAN
+  static bool last_trig = FALSE;
+  bool        trig;
+#endif
+  byte        sw;
+  bool        b;
+#if AMOD_DST != AMOD_OFF
+  int         i;
+  uint8_t     c;
+#endif
+
+  sw = switches_read_mask();
+  uu_keys_scan(&_keys, sw, uu_time_ms());
+  if (uu_keys_pending(&_keys))
+    ctl_raise(IN_SWITCH);
+
+  /* extra delay here a below can pickup switch reading :/ */
+  panel_read(&_panel.wave_cv, IN_WAVE_CV, CCHAN_WAVEFORM);
 
-  state = _sid.chan_3_state;
+  /* Unison spread, also as unison is being turned on */
+  if (_sid.spares == SPARES_DETUNE
+      && (_sid.unison
+	  || (sw & (SWITCH_WAVEFORM|SWITCH_FILTER)) == (SWITCH_WAVEFORM|SWITCH_FILTER)))
+    panel_read(&_panel.detune, IN_DETUNE, CCHAN_SPARE);
 
-  /* Tuning */
-  if ((CHECK_SWITCH(SWITCH_FILTER) && CHECK_SWITCH(SWITCH_RINGSYNC))
-      || (CHECK_SWITCH(SWITCH_FILTER) && (switch_ignore_mask & SWITCH_RINGSYNC))
-      || (CHECK_SWITCH(SWITCH_RINGSYNC) && (switch_ignore_mask & SWITCH_FILTER)))
+  lfo_tick();
+
+#if AMOD_DST != AMOD_OFF
+  i = c = 0; /* off unless the spares are its */
+  if (_sid.spares == SPARES_AMOD)
+    {
+      i = read_chan_analog(AMOD_RATE_CHAN);
+      c = read_chan_analog(AMOD_DEPTH_CHAN) >> 2;
+    }
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-      want_tune = !want_tune;
+      _amod.rate  = (uint16_t)i << AMOD_RATE_SHIFT;
+      _amod.depth = c;
+    }
+#endif
 
-      if (want_tune == FALSE)
-	/* save tune setting */
-	tuning_save();
-      else
-	state = STATE_NONE; /* turn off any ring or sync state 
-			      accidentilly set by pressing ringmod switch */
+#ifdef SAMPLE_TRIG_CHAN
+  trig = read_chan_digital(SAMPLE_TRIG_CHAN);
+  if (trig && !last_trig)
+    sample_play(SAMPLE_KICK);
+  last_trig = trig;
+#endif
+
+  /* CV */
+  panel_read_cv();
 
-      switch_ignore_mask |= (SWITCH_FILTER|SWITCH_RINGSYNC);
+  mod_tick(_panel.cv);
+  if (memcmp(_panel.mod, _mod_out, sizeof(_panel.mod)))
+    {
+      memcpy(_panel.mod, _mod_out, sizeof(_panel.mod));
+      ctl_raise(IN_MOD);
     }
 
-  if (want_tune)
+  panel_read(&_panel.pwm, IN_PWM, CCHAN_PWM);
+  panel_read(&_panel.filt, IN_FILT, CCHAN_FILT);
+  panel_read(&_panel.res, IN_RES, CCHAN_RES);
+  panel_read(&_panel.ringsync, IN_RINGSYNC, CCHAN_RINGSYNC);
+
+  /* Osc 3 pitch, when it is or may be about to be a modulator */
+  if (_sid.chan_3_state != STATE_NONE || _panel.ringsync > 300
+      || (sw & SWITCH_RINGSYNC))
+    panel_read(&_panel.rs_cv, IN_RS_CV, CCHAN_RINGSYNC_CV);
+
+  /* Unison voices wait out a hard restart, catch up once it is done */
+  b = gate_pending(0) || gate_pending(1) || gate_pending(2);
+  if (b || _panel.pending)
+    ctl_raise(SIG_VOICE);
+  _panel.pending = b;
+
+  /* Volume nibble is the sample's while it plays */
+  b = sample_playing();
+  if (b != _panel.playing)
+    ctl_raise(SIG_ROUTE);
+  _panel.playing = b;
+}
+
+/* Gesture actions, n is the repeat count */
+void gesture_tune (uint8_t n)
+{
+  _panel.want_tune = !_panel.want_tune;
+
+  if (_panel.want_tune == FALSE)
+    /* save tune setting */
+    tuning_save();
+  else
     {
-      /* We dont CHECK_SWITCH as we want continuous handling */
-      if (switch_mask & SWITCH_FILTER)
-	{
-	  _tune_offset--;
-	  if (_tune_offset < VOLTS_FREQ_MIN_OFF)
-	    _tune_offset = VOLTS_FREQ_MIN_OFF;
-	}
+      _panel.state = STATE_NONE; /* turn off any ring or sync state 
+				   accidentilly set by pressing ringmod switch */
+      ctl_raise(SIG_STATE);
+    }
 
-      if (switch_mask & SWITCH_RINGSYNC)
-	{
-	  _tune_offset++;
+  ctl_raise(SIG_TUNE);
+}
 
-	  if (_tune_offset > VOLTS_FREQ_MAX_OFF)
-	    _tune_offset = VOLTS_FREQ_MAX_OFF;
-	}
+/* One step a press. Held, it repeats after UU_KEYS_LONG_MS and speeds
+   up to a step every UU_KEYS_REPEAT_MIN_MS, the steps getting bigger
+   the longer it goes. Before the key events it stepped once every
+   control tick for as long as the switch was down, so a single step
+   needed a tap shorter than a tick */
+void gesture_tune_step (int8_t dir, uint8_t n)
+{
+  uint8_t step = 1 + (n >> TUNE_ACCEL_SHIFT);
+
+  if (step > TUNE_STEP_MAX)
+    step = TUNE_STEP_MAX;
+
+  _tune_offset += dir * step;
+
+  if (_tune_offset < VOLTS_FREQ_MIN_OFF)
+    _tune_offset = VOLTS_FREQ_MIN_OFF;
+  if (_tune_offset > VOLTS_FREQ_MAX_OFF)
+    _tune_offset = VOLTS_FREQ_MAX_OFF;
+
+  ctl_raise(SIG_TUNE);
+}
+
+void gesture_tune_down (uint8_t n)
+{
+  gesture_tune_step(-1, n);
+}
+
+void gesture_tune_up (uint8_t n)
+{
+  gesture_tune_step(1, n);
+}
+
+/* 
+ *  - Waveform & Ring/Sync switches held should turn off the waveform... 
+ *  - Waveform display is then blank, no LED lit.
+ *  - Can be turned on again by pressing waveform butten
+ */
+void gesture_gate_off (uint8_t n)
+{
+  if (_sid.gate_off != TRUE)
+    {
+      SID_poke(6,0x00);   // No volume of sustain.. gate is not enough
+      _sid.gate_off = TRUE;
+      panel_sync(); // So gate is toggled.
+      ctl_raise(SIG_WAVE);
     }
+}
 
-  /* 
-   *  - Waveform & Filter switches held should turn off the waveform... 
-   *  - Waveform display is then blank, no LED lit.
-   *  - Can be turned on again by pressing waveform butten
-   */
-  if ((CHECK_SWITCH(SWITCH_WAVEFORM) && CHECK_SWITCH(SWITCH_RINGSYNC))
-      || (CHECK_SWITCH(SWITCH_WAVEFORM) && (switch_ignore_mask & SWITCH_RINGSYNC))
-      || (CHECK_SWITCH(SWITCH_RINGSYNC) && (switch_ignore_mask & SWITCH_WAVEFORM)))
+void gesture_unison (uint8_t n)
+{
+  _sid.unison = !_sid.unison;
+  ctl_raise(SIG_UNISON);
+}
 
+/* While tuning, the unison chord hands the spare inputs on */
+void gesture_spares (uint8_t n)
+{
+  if (++_sid.spares >= SPARES_N)
+    _sid.spares = SPARES_DETUNE;
+}
+
+void gesture_filter (uint8_t n)
+{
+  _sid.filter_type++;
+
+  if (_sid.filter_type > FILTER_NOTCH)
+    _sid.filter_type = FILTER_LP;
+
+  ctl_raise(SIG_FILTER);
+}
+
+void gesture_waveform (uint8_t n)
+{
+  if (_sid.gate_off)
     {
-      switch_ignore_mask |= SWITCH_WAVEFORM;
+      SID_poke(6,ENV_SR); /* Full volume on sustain back on */
+      _sid.gate_off = FALSE;
+      panel_sync();
+    }
+  else
+    _panel.step_wave = TRUE;
 
-      if (_sid.gate_off != TRUE)
-	{
-	  SID_poke(6,0x00);   // No volume of sustain.. gate is not enough
-	  _sid.gate_off = TRUE;
-	  sync_waveform = TRUE; // So gate is toggled.
-	}
+  ctl_raise(SIG_WAVE);
+}
+
+/* Modulation Osc */
+void gesture_ringsync (uint8_t n)
+{
+  if (_sid.gate_off)
+    return;
+
+  _panel.state++;
+
+  if (_panel.state > STATE_SYNC)
+    {
+      panel_sync();
+      _panel.state = STATE_NONE;
     }
-   
-  if (CHECK_SWITCH(SWITCH_FILTER))
+
+  ctl_raise(SIG_STATE);
+}
+
+/* What the switches do, first match wins. Chords are the exact set
+   held, three at once does nothing */
+const Gesture gestures[] PROGMEM = {
+  { UU_KEY_CHORD,  SWITCH_FILTER|SWITCH_RINGSYNC,   GESTURE_ANY,  gesture_tune },
+  { UU_KEY_CHORD,  SWITCH_WAVEFORM|SWITCH_RINGSYNC, GESTURE_ANY,  gesture_gate_off },
+  { UU_KEY_CHORD,  SWITCH_WAVEFORM|SWITCH_FILTER,   GESTURE_PLAY, gesture_unison },
+  { UU_KEY_CHORD,  SWITCH_WAVEFORM|SWITCH_FILTER,   GESTURE_TUNE, gesture_spares },
+  { UU_KEY_PRESS,  SWITCH_FILTER,                   GESTURE_PLAY, gesture_filter },
+  { UU_KEY_PRESS,  SWITCH_WAVEFORM,                 GESTURE_ANY,  gesture_waveform },
+  { UU_KEY_PRESS,  SWITCH_RINGSYNC,                 GESTURE_PLAY, gesture_ringsync },
+  { UU_KEY_PRESS,  SWITCH_FILTER,                   GESTURE_TUNE, gesture_tune_down },
+  { UU_KEY_REPEAT, SWITCH_FILTER,                   GESTURE_TUNE, gesture_tune_down },
+  { UU_KEY_PRESS,  SWITCH_RINGSYNC,                 GESTURE_TUNE, gesture_tune_up },
+  { UU_KEY_REPEAT, SWITCH_RINGSYNC,                 GESTURE_TUNE, gesture_tune_up },
+};
+
+#define GESTURES (sizeof(gestures)/sizeof(Gesture))
+
+/* Switch events through the gesture table */
+uint16_t node_keys ()
+{
+  UUkeyEvent e;
+  Gesture    g;
+  uint8_t    n, when;
+
+  while (uu_keys_event(&_keys, &e))
     {
-      if (!want_tune)
+      when = _panel.want_tune ? GESTURE_TUNE : GESTURE_PLAY;
+
+      for (n = 0; n < GESTURES; n++)
 	{
-	  _sid.filter_type++;
-	  
-	  if (_sid.filter_type > FILTER_NOTCH)
-	    _sid.filter_type = FILTER_LP;
+	  memcpy_P(&g, &gestures[n], sizeof(g));
 
-	  sync_filter = TRUE;
+	  if (g.event == e.type && g.keys == e.keys && (g.when & when))
+	    {
+	      g.fn(e.n);
+	      _panel.save = TRUE;
+	      break;
+	    }
 	}
-
-      switch_ignore_mask |= SWITCH_FILTER;
     }
 
+  return 0;
+}
+
+/* Filter mode and its LEDs */
+uint16_t node_filter ()
+{
+  uint16_t leds = 0;
+  uint8_t  mask = 0;
+
   switch (_sid.filter_type)
     {
     case FILTER_NOTCH:
-      led_mask |= (LED_HI|LED_LO);
-      filter_mask = (CHAN3_OFF|(1<<6)|(0<<5)|(1<<4)|VOLUME);
+      leds = (LED_HI|LED_LO);
+      mask = (CHAN3_OFF|(1<<6)|(0<<5)|(1<<4)|VOLUME);
       break;
     case FILTER_HP:
-      led_mask |= LED_HI;
-      filter_mask = (CHAN3_OFF|(1<<6)|(0<<5)|(0<<4)|VOLUME);
+      leds = LED_HI;
+      mask = (CHAN3_OFF|(1<<6)|(0<<5)|(0<<4)|VOLUME);
       break;
     case FILTER_LP:
-      led_mask |= LED_LO;
-      filter_mask = (CHAN3_OFF|(0<<6)|(0<<5)|(1<<4)|VOLUME);
+      leds = LED_LO;
+      mask = (CHAN3_OFF|(0<<6)|(0<<5)|(1<<4)|VOLUME);
       break;
     case FILTER_BP:
-      led_mask |= LED_MID;
-      filter_mask = (CHAN3_OFF|(0<<6)|(1<<5)|(0<<4)|VOLUME);
+      leds = LED_MID;
+      mask = (CHAN3_OFF|(0<<6)|(1<<5)|(0<<4)|VOLUME);
       break;
     }
 
-  if (first_run)
+  if (mask != _panel.filter_mask)
     {
-      first_run = FALSE;
-      sync_filter = TRUE;
-      sync_waveform = TRUE;
+      _panel.filter_mask = mask;
+      ctl_raise(SIG_ROUTE);
     }
 
+  if (_panel.want_tune)
+    leds |= (LED_HI|LED_LO|LED_MID);
+
+  return leds;
+}
+
+/* Osc 3 ring/sync state from the switch and the mod select pot */
+uint16_t node_state ()
+{
+  uint8_t  state = _panel.state;
+  uint16_t leds = 0;
+  int      i = _panel.ringsync;
+
+  if (i > 300)
+    {
+      if (i < 750)
+	{
+	  state = STATE_SYNC;
+	}
+      else
+	{
+	  state = STATE_RING;
+	}
+
+      if (state != _sid.chan_3_state)
+	_panel.reset_osc1 = TRUE; 		/* Safety on */
+    }
+  else
+    {
+      if (i > 100 && state != STATE_NONE)
+	{
+	  state = STATE_NONE;
+	  panel_sync();
+	  _panel.reset_osc1 = TRUE; 
+	}
+    }
+
+  if (state != _panel.state)
+    {
+      _panel.state = state;
+      ctl_raise(SIG_STATE);
+    }
+
+  if (state == STATE_SYNC && !_sid.gate_off)
+    leds |= LED_SYNC;
+
+  if (state == STATE_RING && !_sid.gate_off)
+    leds |= LED_RING;
+
+  if (_panel.want_tune)
+    leds |= (LED_SYNC|LED_RING);
+
+  return leds;
+}
+
+/* Voice 1 waveform, from the switch or the select pot, and its LEDs */
+uint16_t node_waveform ()
+{
+  int waveform, i;
+
   /* Initial waveform */
   if (_sid.waveform == WAVEFORM_NONE)
     {
       _sid.waveform = waveform = WAVEFORM_PULSE;
-      sync_waveform = TRUE;
+      panel_sync();
     }
   else 
     waveform = _sid.waveform;
 
-  if (CHECK_SWITCH(SWITCH_WAVEFORM))
+  if (_panel.step_wave)
     {
-      if (_sid.gate_off)
-	{
-	  SID_poke(6,0xF0);   /* Full volume on sustain back on */
-	  _sid.gate_off = FALSE;
-	  sync_waveform = TRUE;
-	}
-      else
-	{
-	  waveform = waveform*2;
-	  reset_osc1 = TRUE; 	/* More safety on */
-	}
+      waveform = waveform*2;
+      _panel.reset_osc1 = TRUE; 	/* More safety on */
 
       if (waveform>WAVEFORM_NOISE)
 	waveform = WAVEFORM_TRI;
-
-      switch_ignore_mask |= SWITCH_WAVEFORM;
     }
 
-  /* extra delay here a below can pickup switch reading :/ */
-  i = read_chan_analog(CCHAN_WAVEFORM);
+  i = _panel.wave_cv;
 
   if (i > 50)
     {
@@ -839,203 +1550,435 @@ void cycle ()
 	}
 
       if (waveform != _sid.waveform) 
-	reset_osc1 = TRUE;
+	_panel.reset_osc1 = TRUE;
     }
 
   /* Waveform changed make sure we update */
   if (waveform != _sid.waveform) 
     {
       _sid.waveform = waveform;
-      sync_waveform = TRUE;
+      panel_sync();
     }
 
   /* update LED */
-  if (_sid.gate_off == FALSE)
-    {
-      switch (_sid.waveform)
-	{
-	case WAVEFORM_PULSE:
-	  led_mask |= LED_PULSE;
-	  break;
-	case WAVEFORM_TRI:
-	  led_mask |= LED_TRI;
-	  break;
-	case WAVEFORM_SAW:
-	  led_mask |= LED_SAW;
-	  break;
-	case WAVEFORM_NOISE:
-	  led_mask |= LED_NOISE;
-	  break;
-	}
-    }
+  if (_sid.gate_off)
+    return 0;
 
-  /* CV */
-  i = read_chan_analog(CCHAN_CV);
+  if (_panel.state == STATE_RING)
+    return LED_TRI;
 
-  if (i != _sid.freq_chan_1 || want_tune) /* always set in tuning mode  */
+  switch (_sid.waveform)
     {
-      _sid.freq_chan_1 = i;
-      f = pgm_read_word(&volts_to_freq[i + _tune_offset]);
-      SID_poke(0,f);   /* Send frequency to chanel */
-      SID_poke(1,f>>8);
+    case WAVEFORM_PULSE:
+      return LED_PULSE;
+    case WAVEFORM_TRI:
+      return LED_TRI;
+    case WAVEFORM_SAW:
+      return LED_SAW;
+    case WAVEFORM_NOISE:
+      return LED_NOISE;
     }
 
-  /*  Pulse width */
-  i = (read_chan_analog(CCHAN_PWM) << 2); /* 12 bit value */
+  return 0;
+}
+
+/* Voice 1 pitch */
+uint16_t node_freq ()
+{
+  unsigned int f;
+
+  _sid.freq_chan_1 = _panel.cv;
+  f = mod_freq(_panel.cv + _tune_offset, _mod_out[MOD_DST_FREQ_1]);
+  SID_set(0,f);   /* Queue frequency for chanel, sent once per tick */
+  SID_set(1,f>>8);
+
+  if (_shadow.dirty & (CTL_REG(0)|CTL_REG(1)))
+    ctl_raise(SIG_VOICE);
+
+  return 0;
+}
+
+/*  Pulse width */
+uint16_t node_pw ()
+{
+  int i;
+
+  i = (_panel.pwm << 2); /* 12 bit value */
+  i += _mod_out[MOD_DST_PW] << MOD_PW_SHIFT;
 
   /* 40 * 4 - cuts off so cant be heard */
   if (i<160) i = 160;
   if (i>4095) i = 4095;
 
-  if (i != _sid.pulse_width)
-    {
-      SID_poke(2,uu_bit_low_byte(i));    /* Set pulse width low */
-      SID_poke(3,uu_bit_high_byte(i));   /* Set pulse width high */
-      _sid.pulse_width = i;
-    }
+  /* Ramped there over the next tick from TIMER2, no zipper steps */
+  ramp_set(&_ramp_pw, i, RAMP_STEPS);
+  _sid.pulse_width = i;
+
+  return 0;
+}
+
+/* Filter */
+uint16_t node_cutoff ()
+{
+  int i;
 
-  /* Filter */
-  i = read_chan_analog(CCHAN_FILT) << 1;
+  i = _panel.filt << 1;
+  i += _mod_out[MOD_DST_CUTOFF] << MOD_CUT_SHIFT;
 
   if (i<0) i = 0;
+  if (i>2047) i = 2047;
 
-  if (i != _sid.filter)
-    {
-      SID_poke(21,uu_bit_low_byte(i) & 7);     // Set filter value - 11bits
-      SID_poke(22, uu_bit_high_byte(i << 5));
+  ramp_set(&_ramp_cutoff, i, RAMP_STEPS);
+  _sid.filter = i;
 
-      _sid.filter = i;
-    }
+  return 0;
+}
 
-  /* Resonance 4bit */
-  i = (read_chan_analog(CCHAN_RES) >> 6);
-  if (i<0) i = 0;
-  if (i>15) i = 15;
+/* Osc 3 pitch while it modulates voice 1 */
+uint16_t node_osc3 ()
+{
+  unsigned int f;
 
-  if (i != _sid.resonance) 
+  if (_panel.state != STATE_NONE)
     {
-      SID_poke(23,(i<<4)|9);  /* Set resonance and all channels on */
-      _sid.resonance = i;
-    }
+      _sid.freq_chan_3 = _panel.rs_cv;
 
-  if (sync_filter)
-    {
-      SID_poke(24, filter_mask);
+      f = mod_freq(_panel.rs_cv, _mod_out[MOD_DST_FREQ_3]);
+      /* freq of oscillator 3 */
+      SID_set(14,f); 
+      SID_set(15,f>>8);
     }
 
-  /* Modulation Osc */
-  if (CHECK_SWITCH(SWITCH_RINGSYNC))
+  return 0;
+}
+
+/* Voice 1 control register, in the order the chips want */
+uint16_t node_ctrl ()
+{
+  uint8_t state = _panel.state;
+  uint8_t c;
+
+  if (_panel.sync_waveform || _sid.chan_3_state != state)
     {
-      if (!want_tune && !_sid.gate_off)
-	{
-	  state++;
+      int ring, sync, gate;
 
-	  if (state > STATE_SYNC)
-	    {
-	      sync_waveform = TRUE;
-	      state = STATE_NONE;
-	    }
-	}
-      switch_ignore_mask |= SWITCH_RINGSYNC;
-    }
+      ring = (state == STATE_RING) ? 1 : 0;
+      sync = (state == STATE_SYNC) ? 1 : 0;
+      gate = (_sid.gate_off == TRUE) ? 0 : 1;
 
-  i = read_chan_analog(CCHAN_RINGSYNC);
+      if (state == STATE_NONE && state != _sid.chan_3_state)
+	  /* Make sure oscillator goes off - for swinsid */
+	  SID_poke(18,_sid.waveform|0);
 
-  if (i > 300)
-    {
-      if (i < 750)
+      if (ring) /* must be triangle for ring sinc */
 	{
-	  state = STATE_SYNC;
+	  c = WAVEFORM_TRI|(ring<<2)|(sync<<1);
+	  SID_poke(18,_sid.waveform|gate);
 	}
       else
+	c = _sid.waveform|(ring<<2)|(sync<<1);
+
+      /* New gate, or osc1 changed and used to be gated off by hand to
+	 avoid an odd lockup - hard restart so the attack is on time */
+      if (gate && (!_panel.last_gate || _panel.reset_osc1 || gate_pending(0)))
 	{
-	  state = STATE_RING;
+	  gate_note_on(0, c, ENV_AD, ENV_SR);
+	  _panel.restart = TRUE;
 	}
+      else if (gate)
+	SID_poke(4,c|gate);
+      else
+	gate_note_off(0, c);
 
-      if (state != _sid.chan_3_state)
-	reset_osc1 = TRUE; 		/* Safety on */
+      _panel.last_gate = gate;
+      ctl_raise(SIG_VOICE);
+    }
+
+  _sid.chan_3_state = state;
+
+  return 0;
+}
+
+/* Unison - voice 2, and voice 3 when not a modulator, follow voice 1 */
+uint16_t node_unison ()
+{
+  unsigned int f, d;
+  uint8_t      c, route = 0;
+  bool         unison_3;
+
+  if (_sid.unison)
+    _sid.detune = _panel.detune >> 2;
+
+  unison_3 = (_sid.unison && _sid.chan_3_state == STATE_NONE);
+  f = _shadow.regs[0] | (_shadow.regs[1] << 8);
+  d = uu_mul_u16u8(f, _sid.detune) >> UNISON_DETUNE_SHIFT;
+  c = _sid.waveform | (_sid.gate_off ? 0 : 1);
+
+  if (_sid.unison)
+    {
+      unison_voice(SID_VOICE_2, f + d, c, _panel.restart);
+      route |= FILT_VOICE_2;
     }
   else
+    SID_set(SID_VOICE_2 + 4, _sid.waveform); /* gate off, let it release */
+
+  if (unison_3)
     {
-      if (i > 100 && state != STATE_NONE)
-	{
-	  state = STATE_NONE;
-	  sync_waveform = TRUE;
-	  reset_osc1 = TRUE; 
-	}
+      unison_voice(SID_VOICE_3, f - d, c, _panel.restart);
+      route |= FILT_VOICE_3;
     }
+  else if (_sid.chan_3_state == STATE_NONE)
+    SID_set(SID_VOICE_3 + 4, _sid.waveform);
 
-  if (state == STATE_SYNC && !_sid.gate_off)
-    led_mask |= LED_SYNC;
+  ramp_pw_join(1 | (_sid.unison ? 2 : 0) | (unison_3 ? 4 : 0));
 
-  if (state == STATE_RING && !_sid.gate_off)
+  if (route != _panel.route)
     {
-      led_mask |= LED_RING;
-
-      led_mask &= ~(LED_PULSE|LED_SAW|LED_NOISE);
-      led_mask |= LED_TRI;
+      _panel.route = route;
+      ctl_raise(SIG_ROUTE);
     }
 
-  if (state != STATE_NONE)
-    {
+  return 0;
+}
 
-      i = read_chan_analog(CCHAN_RINGSYNC_CV);
-      if (i != _sid.freq_chan_3)
-	{
-	  _sid.freq_chan_3 = i;
+/* Resonance, filter routing and mode */
+uint16_t node_route ()
+{
+  uint8_t mask = _panel.filter_mask;
+  int     i;
 
-	  f = pgm_read_word(&volts_to_freq[i]);
-	  /* freq of oscillator 3 */
-	  SID_poke(14,f); 
-	  SID_poke(15,f>>8);
-	}
+  /* Resonance 4bit */
+  i = (_panel.res >> 6);
+  i += _mod_out[MOD_DST_RES] >> MOD_RES_SHIFT;
+  if (i<0) i = 0;
+  if (i>15) i = 15;
+
+  _sid.resonance = i;
+
+  SID_set(23, (_sid.resonance<<4)|FILT_ROUTE|_panel.route);  /* Set resonance and channels on */
+
+  if (_panel.route & FILT_VOICE_3)
+    mask &= ~CHAN3_OFF;
+
+  /* The sample owns the volume nibble while it plays */
+  _sample_mode = mask & 0xF0;
+  if (!sample_playing())
+    SID_set(24, mask);
+
+  return 0;
+}
+
+/* One EEPROM write for a gesture, once the switches are let go */
+uint16_t node_save ()
+{
+  if (_panel.save && !uu_keys_down(&_keys))
+    {
+      settings_save();
+      _panel.save = FALSE;
     }
 
-  if (reset_osc1) /* hack to avoid odd lockup with osc1 turning off */
-    SID_poke(4,_sid.waveform|0);
+  return 0;
+}
+
+/* In dependency order */
+const CtlNode ctl_nodes[] PROGMEM = {
+  /* runs on                                 queues regs         drives LEDs */
+  { IN_SWITCH,                               CTL_REG(6),         0,
+    node_keys },
+  { SIG_FILTER|SIG_TUNE,                     0,                  LED_HI|LED_MID|LED_LO,
+    node_filter },
+  { IN_RINGSYNC|SIG_STATE|SIG_WAVE|SIG_TUNE, 0,                  LED_RING|LED_SYNC,
+    node_state },
+  { IN_WAVE_CV|SIG_WAVE|SIG_STATE,           0,                  LED_TRI|LED_SAW|LED_PULSE|LED_NOISE,
+    node_waveform },
+  { IN_CV|IN_MOD|SIG_TUNE,                   CTL_REG(0)|CTL_REG(1), 0,
+    node_freq },
+  { IN_PWM|IN_MOD,                           0,                  0,
+    node_pw },
+  { IN_FILT|IN_MOD,                          0,                  0,
+    node_cutoff },
+  { IN_RS_CV|IN_MOD|SIG_STATE,               CTL_REG(14)|CTL_REG(15), 0,
+    node_osc3 },
+  { SIG_CTRL|SIG_STATE,                      CTL_REG(4)|CTL_REG(18), 0,
+    node_ctrl },
+  { IN_DETUNE|SIG_VOICE|SIG_UNISON|SIG_STATE,
+    CTL_VOICE_REGS(SID_VOICE_2)|CTL_VOICE_REGS(SID_VOICE_3), 0,
+    node_unison },
+  { IN_RES|IN_MOD|SIG_ROUTE,                 CTL_REG(23)|CTL_REG(24), 0,
+    node_route },
+  { IN_SWITCH,                               0,                  0,
+    node_save },
+};
+
+#define CTL_NODES (sizeof(ctl_nodes)/sizeof(CtlNode))
 
-  if (sync_waveform || _sid.chan_3_state != state)
+void cycle () 
+{
+  BENCH_ENTER(BENCH_CYCLE);
+
+  panel_scan();
+
+  ctl_run(ctl_nodes, CTL_NODES);
+
+  _panel.step_wave     = FALSE;
+  _panel.sync_waveform = FALSE;
+  _panel.reset_osc1    = FALSE;
+  _panel.restart       = FALSE;
+
+  /* Commit, the registers the nodes queued then the LEDs */
+  SID_flush();
+
+  /* Background refresh after the real updates, and not while a hard
+     restart or sample wants a steady bus */
+  if (!sample_playing()
+      && !gate_pending(0) && !gate_pending(1) && !gate_pending(2))
+    SID_refresh(SID_REFRESH_PER_TICK);
+
+  if (ctl_leds_changed())
     {
-      int ring, sync, gate;
+      leds_set_mask(_ctl.leds);
+      ctl_leds_sent();
+    }
 
-      ring = (state == STATE_RING) ? 1 : 0;
-      sync = (state == STATE_SYNC) ? 1 : 0;
-      gate = (_sid.gate_off == TRUE) ? 0 : 1;
+  BENCH_LEAVE(BENCH_CYCLE);
+}
 
-      if (state == STATE_NONE && state != _sid.chan_3_state)
-	  /* Make sure oscillator goes off - for swinsid */
-	  SID_poke(18,_sid.waveform|0);
+#if AMOD_DST != AMOD_OFF
+/* One step of the audio rate LFO round the ramped centre, the centre
+   kept in register layout so this is an add and a clamp */
+static inline void amod_step ()
+{
+  uint8_t  v;
+  int16_t  i;
+
+  lfo_update(&_amod);
+
+#if AMOD_DST == AMOD_CUTOFF
+  i = _amod_centre + (lfo_scaled(&_amod) >> 8);
+  SID_poke_fast(22, uu_clamp_u8(i));
+#else
+  i = _amod_centre + (lfo_scaled(&_amod) >> 4);
+  i = (i < 0) ? 0 : (i > 4095) ? 4095 : i;
+  for (v = 0; v < 3; v++)
+    if (_ramp_pw_voices & (1<<v))
+      {
+	SID_poke_fast(v * SID_VOICE_2 + 2, uu_bit_low_byte(i));
+	SID_poke_fast(v * SID_VOICE_2 + 3, uu_bit_high_byte(i));
+      }
+#endif
+}
+#endif
 
-      if (ring) /* must be triangle for ring sinc */
-	{
-	  SID_poke(4,WAVEFORM_TRI|(ring<<2)|(sync<<1)|gate);
-	  SID_poke(18,_sid.waveform|gate);
-	}
-      else
-	SID_poke(4,_sid.waveform|(ring<<2)|(sync<<1)|gate);
+/* Next sample into the volume nibble every 125us, audio rate mod every
+   AMOD_DIV'th. Cutoff and pulse width move a little every 1ms towards
+   the last tick's values, written straight to the chip or left for
+   the audio rate mod to write round */
+ISR(TIMER2_COMPA_vect)
+{
+  static uint8_t div = RAMP_DIV;
+#if AMOD_DST != AMOD_OFF
+  static uint8_t amod_div = AMOD_DIV;
+#endif
+  uint8_t  v;
+  uint16_t i;
+
+  BENCH_ENTER(BENCH_TIMER2);
+
+  gate_tick(); /* first, fixed latency */
+  uu_time_tick();
+
+  if (sample_playing())
+    {
+      v = sample_next();
+      if (!sample_playing())
+	v = VOLUME; /* back to full when done */
+      SID_poke_fast(24, _sample_mode | v);
     }
 
-  _sid.chan_3_state = state;
+#if AMOD_DST != AMOD_OFF
+  if (--amod_div == 0)
+    {
+      amod_div = AMOD_DIV;
+      amod_step();
+    }
+#endif
 
-  if (switch_mask == 0) 	// Nothing pressed so we clear the mask
-    switch_ignore_mask = 0; 	// Maybe a time out here to debounce better?
-  else
-    settings_save(); 		/* something pressed so save settings */
+  if (--div == 0)
+    {
+      div = RAMP_DIV;
 
-  if (want_tune)
-    led_mask |= (LED_HI|LED_LO|LED_MID|LED_SYNC|LED_RING);
+      if (ramp_step(&_ramp_cutoff))
+	{
+	  i = ramp_value(&_ramp_cutoff);
+	  SID_poke_fast(21, uu_bit_low_byte(i) & 7);  // Set filter value - 11bits
+#if AMOD_DST == AMOD_CUTOFF
+	  _amod_centre = uu_bit_high_byte(i << 5);
+#else
+	  SID_poke_fast(22, uu_bit_high_byte(i << 5));
+#endif
+	}
 
-  leds_set_mask(led_mask);
+      if (ramp_step(&_ramp_pw))
+	{
+	  i = ramp_value(&_ramp_pw);
+#if AMOD_DST == AMOD_PW
+	  _amod_centre = i;
+#else
+	  for (v = 0; v < 3; v++)
+	    if (_ramp_pw_voices & (1<<v))
+	      {
+		SID_poke_fast(v * SID_VOICE_2 + 2, uu_bit_low_byte(i));
+		SID_poke_fast(v * SID_VOICE_2 + 3, uu_bit_high_byte(i));
+	      }
+#endif
+	}
+    }
 
+  BENCH_LEAVE(BENCH_TIMER2);
 }
 
+/* Input scanning runs from the main loop so the ramp interrupt can
+   carry on through the ~10ms of mux settling */
 ISR(TIMER1_COMPA_vect)
 {
-  cycle();
+  _tick = TRUE;
+}
+
+/* Only wakes analog_read() */
+ISR(ADC_vect)
+{
 }
 
 int main(void)
 {
+#ifdef BENCH
+  bench_init();
+#endif
   setup();
-  while (TRUE);
+#ifdef BENCH
+  bench_run();
+#endif
+  while (TRUE)
+    {
+      cli();
+      if (!_tick)
+	{
+	  sleep_enable();
+	  sei();
+	  sleep_cpu(); /* until the next interrupt */
+	  sleep_disable();
+	}
+      sei();
+
+      uu_time_run();
+
+      if (_tick)
+	{
+	  _tick = FALSE;
+	  if (soundcheck_running())
+	    soundcheck_tick();
+	  else
+	    cycle();
+	}
+    }
 }
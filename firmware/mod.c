@@ -0,0 +1,73 @@
+/*
+  'SID GUTS' firmware - modulation matrix
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "mod.h"
+#include "uu_fixmath.h"
+
+/* Stock routings, none of which change the stock sound. LFO 1 is pulse
+   width modulation once the spare inputs give it a depth, the rest wait
+   at depth 0. Nothing edits or saves the slots yet, so these are what
+   every boot runs */
+const ModSlot mod_defaults[MOD_SLOTS] PROGMEM = {
+  { MOD_SRC_LFO_1,   MOD_DST_PW,     64 },
+  { MOD_SRC_LFO_2,   MOD_DST_CUTOFF, 0 },
+  { MOD_SRC_CV,      MOD_DST_CUTOFF, 0 },  /* filter keytracking */
+  { MOD_SRC_CV,      MOD_DST_PW,     0 },
+  { MOD_SRC_RANDOM,  MOD_DST_CUTOFF, 0 },
+  { MOD_SRC_SPARE_1, MOD_DST_FREQ_3, 0 },
+};
+
+ModSlot _mod_slots[MOD_SLOTS];
+int8_t  _mod_src[MOD_SRC_N];
+int16_t _mod_out[MOD_DST_N];
+
+void
+mod_init ()
+{
+  memcpy_P(_mod_slots, mod_defaults, sizeof(_mod_slots));
+}
+
+void
+mod_eval ()
+{
+  ModSlot *s = _mod_slots;
+  uint8_t  n;
+
+  for (n = 0; n < MOD_DST_N; n++)
+    _mod_out[n] = 0;
+
+  /* No test for unused slots, depth 0 adds nothing */
+  for (n = 0; n < MOD_SLOTS; n++, s++)
+    _mod_out[s->dst] += uu_mul_s8(_mod_src[s->src], s->depth) >> 7;
+}
+
+/* Sources some slot actually uses, so unused inputs need not be read */
+uint8_t
+mod_sources_used ()
+{
+  uint8_t n, used = 0;
+
+  for (n = 0; n < MOD_SLOTS; n++)
+    if (_mod_slots[n].depth)
+      used |= _BV(_mod_slots[n].src);
+
+  return used;
+}
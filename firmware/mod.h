@@ -0,0 +1,72 @@
+/*
+  'SID GUTS' firmware - modulation matrix
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_MOD_H
+#define _HAVE_MOD_H
+
+#include <stdint.h>
+
+/*
+ * Table driven modulation. Sources are signed 8 bit, each slot adds
+ * source * depth / 128 to its destination. Every slot is evaluated
+ * every tick, unused ones just have depth 0, so the cost is fixed.
+ */
+
+/* Sources */
+#define MOD_SRC_CV      0
+#define MOD_SRC_SPARE_1 1 /* mux input 8, 0 while audio rate mod has it */
+#define MOD_SRC_SPARE_2 2 /* mux input 15, 0 unless set to SPARES_MOD */
+#define MOD_SRC_LFO_1   3
+#define MOD_SRC_LFO_2   4
+#define MOD_SRC_RANDOM  5 /* S&H */
+#define MOD_SRC_OSC3    6 /* voice 3 read back from the SID, */
+#define MOD_SRC_ENV3    7 /* only with SID_READBACK */
+#define MOD_SRC_N       8
+
+/* Destinations */
+#define MOD_DST_FREQ_1  0
+#define MOD_DST_PW      1
+#define MOD_DST_CUTOFF  2
+#define MOD_DST_RES     3
+#define MOD_DST_FREQ_3  4
+#define MOD_DST_N       5
+
+#define MOD_SLOTS       6
+
+typedef struct _ModSlot
+{
+  uint8_t src;
+  uint8_t dst;
+  int8_t  depth;
+} ModSlot;
+
+extern ModSlot _mod_slots[MOD_SLOTS];
+extern int8_t  _mod_src[MOD_SRC_N];
+extern int16_t _mod_out[MOD_DST_N];
+
+void    mod_init ();
+void    mod_eval ();
+uint8_t mod_sources_used ();
+
+/* Bipolar source from a 10 bit reading */
+#define mod_from_pot(v) ((int8_t)(((v) >> 2) - 128))
+
+#endif
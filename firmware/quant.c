@@ -0,0 +1,86 @@
+/*
+  'SID GUTS' firmware - pitch CV scale quantiser
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "quant.h"
+
+#if (QUANT_USER_SCALE & 0xfff) == 0
+#error "QUANT_USER_SCALE needs at least one note"
+#endif
+
+/* Nearest note of scale mask m to semitone p of the octave, a tie goes
+   down. May land in the octave either side */
+#define QBIT(m, p) (((m) >> (((p) + 12) % 12)) & 1)
+#define QNEAR(m, p, d, n)				\
+  (QBIT(m, (p) - (d)) ? (p) - (d) : QBIT(m, (p) + (d)) ? (p) + (d) : (n))
+#define QSNAP(m, p)							\
+  (QBIT(m, p) ? (p) : QNEAR(m, p, 1, QNEAR(m, p, 2, QNEAR(m, p, 3,	\
+   QNEAR(m, p, 4, QNEAR(m, p, 5, (p) - 6))))))
+#define QSCALE(m)							\
+  { QSNAP(m, 0), QSNAP(m, 1), QSNAP(m, 2), QSNAP(m, 3),			\
+    QSNAP(m, 4), QSNAP(m, 5), QSNAP(m, 6), QSNAP(m, 7),			\
+    QSNAP(m, 8), QSNAP(m, 9), QSNAP(m, 10), QSNAP(m, 11) }
+
+const int8_t quant_snap[QUANT_SCALES - 1][12] PROGMEM = {
+  QSCALE(0xfff),            /* chromatic */
+  QSCALE(0xab5),            /* major */
+  QSCALE(0x5ad),            /* minor */
+  QSCALE(0x295),            /* pentatonic */
+  QSCALE(QUANT_USER_SCALE)
+};
+
+void
+quant_init (Quant *quant, uint8_t scale)
+{
+  quant->scale = (scale < QUANT_SCALES) ? scale : QUANT_OFF;
+  quant->semi  = 0;
+}
+
+/* CV reading to the reading at the centre of its note */
+int
+quant_cv (Quant *quant, int cv)
+{
+  int16_t pos, mid;
+  int8_t  note;
+
+  if (quant->scale == QUANT_OFF)
+    return cv;
+
+  /* 1/256 semitones, a new note only well past the boundary */
+  pos = cv * 15;
+  mid = (int16_t)quant->semi << 8;
+  if (pos > mid + 128 + QUANT_HYST || pos < mid - 128 - QUANT_HYST)
+    quant->semi = (pos + 128) >> 8;
+
+  note = quant->semi - quant->semi % 12
+    + (int8_t)pgm_read_byte(&quant_snap[quant->scale - 1][quant->semi % 12]);
+
+  /* Nearest degree is below 0V, only a scale without its root does that.
+     Take the lowest one there is rather than the top of the octave, the
+     lowest being the first that snaps to itself */
+  if (note < 0)
+    for (note = 0;
+	 (int8_t)pgm_read_byte(&quant_snap[quant->scale - 1][note]) != note;
+	 note++)
+      ;
+
+  /* Back to counts, 273/16 for 256/15 */
+  return MIN(((uint16_t)note * 273 + 8) >> 4, 1023);
+}
@@ -0,0 +1,59 @@
+/*
+  'SID GUTS' firmware - pitch CV scale quantiser
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_QUANT_H
+#define _HAVE_QUANT_H
+
+#include <stdint.h>
+
+/*
+ * Snaps a 1V/oct CV reading (1024 counts over 5V, 256/15 counts a
+ * semitone) to the centre of the nearest note of a scale. The chromatic
+ * note has hysteresis either side of each boundary, so a reading
+ * sitting on one doesn't flip between notes. Scale degrees are a
+ * PROGMEM table per scale built by the preprocessor from a 12 bit mask,
+ * bit 0 the note at 0V.
+ */
+
+#define QUANT_OFF        0 /* reading passed through */
+#define QUANT_CHROMATIC  1
+#define QUANT_MAJOR      2
+#define QUANT_MINOR      3 /* natural */
+#define QUANT_PENTATONIC 4 /* major */
+#define QUANT_USER       5
+#define QUANT_SCALES     6
+
+#ifndef QUANT_USER_SCALE
+#define QUANT_USER_SCALE 0x4a9 /* minor pentatonic */
+#endif
+
+#define QUANT_HYST       64 /* past half way, in 1/256 semitones */
+
+typedef struct _Quant
+{
+  uint8_t scale;
+  uint8_t semi;  /* chromatic note held, semitones above 0V */
+} Quant;
+
+void quant_init (Quant *quant, uint8_t scale);
+int  quant_cv (Quant *quant, int cv);
+
+#endif
@@ -0,0 +1,56 @@
+/*
+  'SID GUTS' firmware - sub tick ramps
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "ramp.h"
+#include <util/atomic.h>
+
+/* New target from main context, the interrupt carries on from wherever
+   the last ramp had got to */
+void
+ramp_set (Ramp *ramp, uint16_t target, uint8_t steps)
+{
+  target <<= RAMP_FRAC;
+
+  if (target == ramp->target)
+    return;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      ramp->target = target;
+      ramp->step = ((int16_t)(target - ramp->value)) / steps;
+      ramp->steps = steps;
+    }
+}
+
+/* From the interrupt, TRUE if the value moved */
+bool
+ramp_step (Ramp *ramp)
+{
+  if (!ramp->steps)
+    return FALSE;
+
+  if (--ramp->steps)
+    ramp->value += ramp->step;
+  else
+    ramp->value = ramp->target; /* land exactly */
+
+  return TRUE;
+}
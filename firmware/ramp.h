@@ -0,0 +1,49 @@
+/*
+  'SID GUTS' firmware - sub tick ramps
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_RAMP_H
+#define _HAVE_RAMP_H
+
+#include <stdint.h>
+
+/*
+ * Linear ramp from the current value to a new target over a fixed
+ * number of steps, stepped from a timer interrupt. Values keep 3
+ * fraction bits, enough that a full 12 bit pulse width swing still
+ * fits the signed 16 bit step.
+ */
+
+#define RAMP_FRAC 3
+
+typedef struct _Ramp
+{
+  uint16_t value;
+  uint16_t target;
+  int16_t  step;
+  uint8_t  steps;  /* left to go */
+} Ramp;
+
+void ramp_set (Ramp *ramp, uint16_t target, uint8_t steps);
+bool ramp_step (Ramp *ramp);
+
+#define ramp_value(ramp) ((ramp)->value >> RAMP_FRAC)
+
+#endif
@@ -0,0 +1,121 @@
+/*
+  'SID GUTS' firmware - digi samples
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "sample.h"
+#include <util/atomic.h>
+
+/* 160ms of 8kHz kick, 150Hz falling to 50Hz */
+const uint8_t sample_kick[] PROGMEM = {
+  0x9a, 0xbb, 0xcd, 0xde, 0xef, 0xff, 0xff, 0xff, 0xfe, 0xed, 0xdc, 0xbb,
+  0xa9, 0x88, 0x76, 0x55, 0x44, 0x33, 0x22, 0x21, 0x11, 0x11, 0x22, 0x23,
+  0x34, 0x45, 0x56, 0x77, 0x89, 0x9a, 0xbb, 0xcc, 0xdd, 0xde, 0xee, 0xee,
+  0xee, 0xee, 0xed, 0xdd, 0xcc, 0xbb, 0xaa, 0x98, 0x87, 0x76, 0x65, 0x54,
+  0x43, 0x33, 0x32, 0x22, 0x22, 0x22, 0x33, 0x33, 0x44, 0x45, 0x56, 0x67,
+  0x78, 0x89, 0x9a, 0xaa, 0xbb, 0xcc, 0xcd, 0xdd, 0xdd, 0xdd, 0xdd, 0xdd,
+  0xdd, 0xdc, 0xcc, 0xbb, 0xba, 0xa9, 0x99, 0x88, 0x77, 0x76, 0x65, 0x55,
+  0x44, 0x44, 0x43, 0x33, 0x33, 0x33, 0x33, 0x33, 0x44, 0x44, 0x55, 0x56,
+  0x66, 0x77, 0x78, 0x88, 0x99, 0x9a, 0xaa, 0xbb, 0xbb, 0xcc, 0xcc, 0xcc,
+  0xcc, 0xdd, 0xcc, 0xcc, 0xcc, 0xcc, 0xbb, 0xbb, 0xba, 0xaa, 0x99, 0x98,
+  0x88, 0x87, 0x77, 0x66, 0x66, 0x55, 0x55, 0x54, 0x44, 0x44, 0x44, 0x44,
+  0x44, 0x44, 0x44, 0x45, 0x55, 0x55, 0x56, 0x66, 0x67, 0x77, 0x78, 0x88,
+  0x89, 0x99, 0x9a, 0xaa, 0xaa, 0xbb, 0xbb, 0xbb, 0xbb, 0xcc, 0xcc, 0xcc,
+  0xcc, 0xcc, 0xbb, 0xbb, 0xbb, 0xbb, 0xaa, 0xaa, 0xa9, 0x99, 0x99, 0x88,
+  0x88, 0x87, 0x77, 0x77, 0x66, 0x66, 0x66, 0x55, 0x55, 0x55, 0x55, 0x55,
+  0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x66, 0x66, 0x66, 0x67, 0x77,
+  0x77, 0x88, 0x88, 0x88, 0x99, 0x99, 0x99, 0xaa, 0xaa, 0xaa, 0xaa, 0xab,
+  0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xaa, 0xaa, 0xaa,
+  0xaa, 0xa9, 0x99, 0x99, 0x99, 0x88, 0x88, 0x88, 0x87, 0x77, 0x77, 0x77,
+  0x76, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x65, 0x55, 0x55, 0x55, 0x66,
+  0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x77, 0x77, 0x77, 0x77, 0x78, 0x88,
+  0x88, 0x88, 0x88, 0x99, 0x99, 0x99, 0x99, 0x9a, 0xaa, 0xaa, 0xaa, 0xaa,
+  0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa,
+  0xa9, 0x99, 0x99, 0x99, 0x99, 0x98, 0x88, 0x88, 0x88, 0x88, 0x88, 0x77,
+  0x77, 0x77, 0x77, 0x77, 0x77, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+  0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x77, 0x77, 0x77, 0x77, 0x77,
+  0x77, 0x77, 0x78, 0x88, 0x88, 0x88, 0x88, 0x88, 0x89, 0x99, 0x99, 0x99,
+  0x99, 0x99, 0x99, 0x99, 0x99, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa,
+  0xaa, 0xaa, 0xa9, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x87, 0x77, 0x77, 0x77, 0x77,
+  0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77,
+  0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x99, 0x99, 0x99, 0x99,
+  0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99,
+  0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x98, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x87, 0x77, 0x77,
+  0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77,
+  0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x78, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99,
+  0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x87, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77,
+  0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x77, 0x78,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x89, 0x99, 0x99, 0x99,
+  0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x99, 0x98,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x87, 0x77, 0x77, 0x77, 0x77, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88,
+  0x88, 0x88, 0x88, 0x88
+};
+
+const Sample samples[SAMPLE_N] PROGMEM = {
+  { sample_kick, sizeof(sample_kick) * 2 },
+};
+
+SamplePlayer _sample;
+
+/* Restarts if already playing */
+void sample_play (uint8_t n)
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+      _sample.pos  = (const uint8_t *)pgm_read_word(&samples[n].data);
+      _sample.left = pgm_read_word(&samples[n].len);
+    }
+}
+
+void sample_stop ()
+{
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    _sample.left = 0;
+}
+
+/* From the Timer2 interrupt, only while sample_playing() */
+uint8_t sample_next ()
+{
+  uint8_t nib;
+
+  if (_sample.left & 1)
+    nib = _sample.byte & 0x0F;
+  else
+    {
+      _sample.byte = pgm_read_byte(_sample.pos++);
+      nib = _sample.byte >> 4;
+    }
+
+  _sample.left--;
+
+  return nib;
+}
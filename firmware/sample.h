@@ -0,0 +1,61 @@
+/*
+  'SID GUTS' firmware - digi samples
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_SAMPLE_H
+#define _HAVE_SAMPLE_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+/*
+ * 4 bit samples played through the master volume nibble of register 24.
+ * Every volume change steps the chip's output DC level, which is loud
+ * on a 6581 and faint on an 8580. Two samples per byte, high nibble
+ * first, 8 is silence.
+ */
+
+#define SAMPLE_HZ   8000 /* Timer2 rate, the ramps step off a divider */
+
+#define SAMPLE_KICK 0
+#define SAMPLE_N    1
+
+typedef struct _Sample
+{
+  const uint8_t *data;
+  uint16_t       len;   /* in samples, even */
+} Sample;
+
+typedef struct _SamplePlayer
+{
+  const uint8_t *pos;
+  volatile uint16_t left;
+  uint8_t        byte;
+} SamplePlayer;
+
+extern SamplePlayer _sample;
+
+void    sample_play (uint8_t n);
+void    sample_stop ();
+uint8_t sample_next ();
+
+#define sample_playing() (_sample.left != 0)
+
+#endif
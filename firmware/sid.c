@@ -0,0 +1,389 @@
+/*
+  'SID GUTS' firmware - SID bus
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "bench.h"
+#include "sid.h"
+
+SIDshadow _shadow;
+volatile uint8_t _sid_held = FALSE;
+
+#if SID_CHIPS > 1
+SIDshadow _shadow_2;
+uint8_t   _sid_mode = SID_MODE_SINGLE;
+#endif
+
+/* Anything on the data ports that must stay high while we drive them */
+#define SID_IDLE_B (0x10 | (SID2_ON_PORT(PORTB) ? SID2_CS_MASK : 0))
+#define SID_IDLE_D (SID2_ON_PORT(PORTD) ? SID2_CS_MASK : 0)
+
+/* LED lines sharing the ports, left alone so a write from an interrupt
+   can't upset an LED update in progress. 0 for B once the LED is moved */
+#ifndef SID_KEEP_B
+#define SID_KEEP_B 0x20 /* PB5 LED_I */
+#endif
+#define SID_KEEP_D 0x03 /* PD0/PD1 LED data & enable */
+
+/* Ports can't be compared by the preprocessor, GCC folds the addresses */
+#define SID_CLASH(port, mask)						\
+  ((&(port) == &PORTB && ((mask) & SID_KEEP_B))				\
+   || (&(port) == &PORTD && ((mask) & SID_KEEP_D)))
+
+#if SID_CHIPS > 1
+_Static_assert(!SID_CLASH(SID2_CS_PORT, SID2_CS_MASK),
+	       "SID2_CS_MASK is on an LED line, see sid.h");
+#endif
+#ifdef SID_READBACK
+_Static_assert(!SID_CLASH(SID_RW_PORT, SID_RW_MASK),
+	       "SID_RW_MASK is on an LED line, see sid.h");
+#if SID_CHIPS > 1
+_Static_assert(&SID_RW_PORT != &SID2_CS_PORT
+	       || !(SID_RW_MASK & SID2_CS_MASK),
+	       "SID_RW_MASK is the second chip's /CS");
+#endif
+#endif
+
+/* Normal writes hold each strobe 10us, as SwinSID wants. The fast path
+   for interrupts holds just over a phi2 cycle */
+#define sid_hold(fast) \
+  do { if (fast) _delay_us(1); else _delay_us(10); } while (0)
+
+/* Register the 74LS174 holds, repeat writes to it skip the address
+   strobe. Only touched with interrupts off */
+static uint8_t _sid_latched = 0xFF;
+
+static void sid_address (uint8_t port, bool fast)
+{
+  if (port == _sid_latched)
+    return;
+  _sid_latched = port;
+
+  PORTB = (PORTB & SID_KEEP_B) | SID_IDLE_B
+    | (port & 0x0F);                    // Lower bit, keep CS deactive
+  PORTD = (PORTD & SID_KEEP_D) | SID_IDLE_D
+    | (((port | 0x20) & 0xF0) >> 2);    // Upper bit, reset high
+  PORTD |= 0x80;                        // Clock in Address
+  sid_hold(fast);
+  PORTD &= ~(0x80);
+}
+
+static void sid_data (uint8_t data, uint8_t chips, bool fast)
+{
+  PORTB = (PORTB & SID_KEEP_B) | SID_IDLE_B
+    | (data & 0x0F);                    // Lower bit, keep CS deactive
+  PORTD = (PORTD & SID_KEEP_D) | SID_IDLE_D
+    | ((data & 0xF0) >> 2);             // Upper bit
+  if (chips & SID_CHIP_1)
+    PORTB &= ~(0x10);   // Activate /CS
+#if SID_CHIPS > 1
+  if (chips & SID_CHIP_2)
+    SID2_CS_PORT &= ~SID2_CS_MASK;
+#endif
+  sid_hold(fast);
+  PORTB |= 0x10;      // Deactivate /CS
+#if SID_CHIPS > 1
+  SID2_CS_PORT |= SID2_CS_MASK;
+#endif
+}
+
+/* One address setup, then the data for one or both chips. Interrupts
+   are held off so the fast path can't cut in half way */
+static void sid_write (uint8_t port, uint8_t chips, uint8_t data, uint8_t data_2)
+{
+  uint32_t bit = (port < SID_REGS) ? (1UL << port) : 0;
+  uint8_t  sreg = SREG;
+
+  if (_sid_held)
+    return; /* stays dirty for SID_replay() */
+
+  BENCH_ENTER(BENCH_SID_POKE);
+
+  cli();
+
+  sid_address(port, FALSE);
+
+#if SID_CHIPS > 1
+  if (chips == (SID_CHIP_1|SID_CHIP_2) && data == data_2)
+    sid_data(data, chips, FALSE); /* both at once */
+  else
+    {
+      if (chips & SID_CHIP_1)
+	sid_data(data, SID_CHIP_1, FALSE);
+      if (chips & SID_CHIP_2)
+	sid_data(data_2, SID_CHIP_2, FALSE);
+    }
+
+  if (chips & SID_CHIP_2)
+    {
+      _shadow_2.dirty &= ~bit;
+      sid_trace(1, port, data_2);
+    }
+#else
+  sid_data(data, chips, FALSE);
+#endif
+
+  SREG = sreg;
+
+  if (chips & SID_CHIP_1)
+    {
+      _shadow.dirty &= ~bit;
+      sid_trace(0, port, data);
+    }
+
+  BENCH_LEAVE(BENCH_SID_POKE);
+}
+
+/*
+ * Write from interrupt context, ~3us, or ~1.5us when the register is
+ * the one latched last. Skips the write if the chip has the value
+ * already. Chip 2 gets the same data unless it is silent or driven
+ * separately.
+ */
+void SID_poke_fast (uint8_t port, uint8_t data)
+{
+  uint8_t chips = SID_CHIP_1;
+
+  if (_shadow.regs[port] == data)
+    return;
+
+  _shadow.regs[port] = data;
+
+#if SID_CHIPS > 1
+  if (_sid_mode != SID_MODE_SINGLE && _sid_mode != SID_MODE_SPLIT)
+    {
+      _shadow_2.regs[port] = data;
+      chips |= SID_CHIP_2;
+    }
+#endif
+
+  if (_sid_held)
+    return;
+
+  sid_address(port, TRUE);
+  sid_data(data, chips, TRUE);
+
+  sid_trace(0, port, data);
+}
+
+#ifdef SID_READBACK
+/* Read a register from chip 1, only 25..28 mean anything */
+uint8_t SID_peek (uint8_t port)
+{
+  uint8_t data, sreg = SREG;
+
+  BENCH_ENTER(BENCH_SID_POKE);
+
+  cli();
+
+  sid_address(port, FALSE);
+
+  /* Let go of the data bus, no pull ups */
+  DDRB  &= ~0x0F;
+  DDRD  &= ~0x3C;
+  PORTB &= ~0x0F;
+  PORTD &= ~0x3C;
+
+  SID_RW_PORT |= SID_RW_MASK; // Read
+  PORTB &= ~(0x10);           // Activate /CS
+  _delay_us(2);               // Over a full phi2 cycle, data valid
+  data = (PINB & 0x0F) | ((PIND & 0x3C) << 2);
+  PORTB |= 0x10;              // Deactivate /CS
+  SID_RW_PORT &= ~SID_RW_MASK;
+
+  DDRB  |= 0x0F;
+  DDRD  |= 0x3C;
+
+  SREG = sreg;
+
+  BENCH_LEAVE(BENCH_SID_POKE);
+
+  return data;
+}
+#endif
+
+#if SID_CHIPS > 1
+/* Queue on chip 2 what the mode says it holds for a chip 1 register */
+static void sid_mirror (uint8_t port)
+{
+  uint8_t      voice;
+  unsigned int f, f2;
+
+  if (_sid_mode == SID_MODE_SINGLE || _sid_mode == SID_MODE_SPLIT
+      || port >= SID_REGS)
+    return;
+
+  if (_sid_mode == SID_MODE_STEREO && port < SID_VOICE_3 + SID_VOICE_2
+      && (port % SID_VOICE_2) <= SID_FREQ_HI)
+    {
+      /* Right side slightly sharp for width */
+      voice = port - (port % SID_VOICE_2);
+      f = _shadow.regs[voice + SID_FREQ_LO]
+	| (_shadow.regs[voice + SID_FREQ_HI] << 8);
+      f2 = f + (f >> SID_STEREO_SHIFT);
+      if (f2 < f)
+	f2 = 0xffff;
+
+      SID_set_2(voice + SID_FREQ_LO, f2);
+      SID_set_2(voice + SID_FREQ_HI, f2>>8);
+      return;
+    }
+
+  SID_set_2(port, _shadow.regs[port]);
+}
+#else
+#define sid_mirror(port)
+#endif
+
+/* Write straight to the chip(s), for writes whose order matters */
+void SID_poke (uint8_t port, uint8_t data) 
+{
+  uint8_t chips = SID_CHIP_1;
+
+  if (port < SID_REGS)
+    _shadow.regs[port] = data;
+
+#if SID_CHIPS > 1
+  sid_mirror(port);
+
+  if (port < SID_REGS && (_shadow_2.dirty & (1UL << port)))
+    chips |= SID_CHIP_2;
+
+  sid_write(port, chips, data, _shadow_2.regs[port]);
+#else
+  sid_write(port, chips, data, 0);
+#endif
+}  
+
+/* Queue a register write, only if it changes what the chip has */
+void SID_set (uint8_t port, uint8_t data)
+{
+  if (_shadow.regs[port] == data)
+    return;
+
+  _shadow.regs[port] = data;
+  _shadow.dirty |= (1UL << port);
+
+  sid_mirror(port);
+}
+
+/* Send all queued writes in one burst, chips share each address setup */
+void SID_flush ()
+{
+  uint8_t  port, chips;
+#if SID_CHIPS > 1
+  uint32_t dirty = _shadow.dirty | _shadow_2.dirty;
+#else
+  uint32_t dirty = _shadow.dirty;
+#endif
+
+  for (port = 0; dirty; port++, dirty >>= 1)
+    if (dirty & 1)
+      {
+#if SID_CHIPS > 1
+	chips = 0;
+	if (_shadow.dirty & (1UL << port))
+	  chips |= SID_CHIP_1;
+	if (_shadow_2.dirty & (1UL << port))
+	  chips |= SID_CHIP_2;
+
+	sid_write(port, chips, _shadow.regs[port], _shadow_2.regs[port]);
+#else
+	chips = SID_CHIP_1;
+	sid_write(port, chips, _shadow.regs[port], 0);
+#endif
+      }
+}
+
+/* Writes only go to the shadow until SID_replay(), for a chip that is
+   still starting up */
+void SID_hold ()
+{
+  _sid_held = TRUE;
+}
+
+/* Send the whole register image again, ending any hold. Safe to repeat
+   for chips that miss writes early on */
+void SID_replay ()
+{
+  _shadow.dirty = (1UL << SID_REGS) - 1;
+#if SID_CHIPS > 1
+  _shadow_2.dirty = (1UL << SID_REGS) - 1;
+#endif
+  _sid_held = FALSE;
+
+  SID_flush();
+}
+
+/* Rewrite the next n registers of the image whether changed or not, so
+   a chip that lost state (brown out, SwinSID reset, bus glitch) comes
+   back within a pass. Both chips take turns */
+void SID_refresh (uint8_t n)
+{
+  static uint8_t next = 0;
+  uint8_t        port, sreg;
+
+  if (_sid_held)
+    return;
+
+  while (n--)
+    {
+      port = next % SID_REGS;
+      sreg = SREG;
+      cli(); /* the fast path can't change it between read and write */
+#if SID_CHIPS > 1
+      if (next >= SID_REGS)
+	sid_write(port, SID_CHIP_2, 0, _shadow_2.regs[port]);
+      else
+#endif
+	sid_write(port, SID_CHIP_1, _shadow.regs[port], 0);
+      SREG = sreg;
+
+      if (++next >= SID_REGS * SID_CHIPS)
+	next = 0;
+    }
+}
+
+#if SID_CHIPS > 1
+/* Queue a write to chip 2 only, for SID_MODE_SPLIT users */
+void SID_set_2 (uint8_t port, uint8_t data)
+{
+  if (_shadow_2.regs[port] == data)
+    return;
+
+  _shadow_2.regs[port] = data;
+  _shadow_2.dirty |= (1UL << port);
+}
+
+/* Change what chip 2 does, it is brought in line on the next flush */
+void SID_mode (uint8_t mode)
+{
+  uint8_t port;
+
+  _sid_mode = mode;
+
+  for (port = 0; port < SID_REGS; port++)
+    {
+      if (mode == SID_MODE_SINGLE)
+	SID_set_2(port, 0);
+      else
+	sid_mirror(port);
+    }
+}
+#endif
@@ -0,0 +1,135 @@
+/*
+  'SID GUTS' firmware - SID bus
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_SID_H
+#define _HAVE_SID_H
+
+#include <stdint.h>
+
+/*
+ * SID on the PORTB/PORTD bus. Address goes through the '174 latch
+ * clocked by PD7, data is then strobed in with /CS on PB4.
+ */
+
+#ifndef SID_CHIPS
+#define SID_CHIPS   1
+#endif
+
+/*
+ * A second chip shares the bus and needs its own /CS. There is no spare
+ * pin on the stock board, one has to be freed, e.g. the sync LED on PB5
+ * (PIN_LED_I in main.c) moved elsewhere, then
+ *   -DSID_CHIPS=2 -DSID2_CS_PORT=PORTB -DSID2_CS_MASK=0x20 -DSID_KEEP_B=0
+ */
+#if SID_CHIPS > 1
+#if !defined(SID2_CS_PORT) || !defined(SID2_CS_MASK)
+#error "SID_CHIPS > 1 needs SID2_CS_PORT and SID2_CS_MASK for the second /CS"
+#endif
+#define SID2_ON_PORT(p) (&SID2_CS_PORT == &(p))
+#else
+#define SID2_ON_PORT(p) 0
+#define SID2_CS_MASK    0
+#endif
+
+/*
+ * Reading registers back needs R/W on a pin, it is tied for write on
+ * the stock board. Same as the second /CS, a pin has to be freed first,
+ * and it can't be the one that went to the second chip:
+ *   -DSID_READBACK -DSID_RW_PORT=PORTB -DSID_RW_MASK=0x20 -DSID_KEEP_B=0
+ * sid.c refuses to build with R/W or the second /CS on an LED line.
+ */
+#ifdef SID_READBACK
+#if !defined(SID_RW_PORT) || !defined(SID_RW_MASK)
+#error "SID_READBACK needs SID_RW_PORT and SID_RW_MASK for the R/W line"
+#endif
+#endif
+
+#define SID_OSC3    27 /* read only, voice 3 waveform upper 8 bits */
+#define SID_ENV3    28 /* read only, voice 3 envelope */
+
+#define SID_CHIP_1  (1<<0)
+#define SID_CHIP_2  (1<<1)
+
+/* What chip 2 does */
+#define SID_MODE_SINGLE 0 /* silent */
+#define SID_MODE_DOUBLE 1 /* same as chip 1, doubled voices and filters */
+#define SID_MODE_STEREO 2 /* same as chip 1 but slightly sharp */
+#define SID_MODE_SPLIT  3 /* driven separately through SID_set_2() */
+
+#ifndef SID_DUAL_MODE
+#define SID_DUAL_MODE   SID_MODE_DOUBLE
+#endif
+
+#define SID_STEREO_SHIFT 9 /* ~3.4 cents */
+
+#define SID_REGS    25
+
+/* Voice register blocks, and registers within a block */
+#define SID_VOICE_1 0
+#define SID_VOICE_2 7
+#define SID_VOICE_3 14
+
+#define SID_FREQ_LO 0
+#define SID_FREQ_HI 1
+#define SID_PW_LO   2
+#define SID_PW_HI   3
+#define SID_CTRL    4
+#define SID_AD      5
+#define SID_SR      6
+
+/* Last value sent to each SID register, and those waiting to go out */
+typedef struct _SIDShadow
+{
+  uint8_t  regs[SID_REGS];
+  uint32_t dirty;
+} SIDshadow;
+
+extern SIDshadow _shadow;
+extern volatile uint8_t _sid_held;
+
+void SID_poke (uint8_t port, uint8_t data);
+void SID_set (uint8_t port, uint8_t data);
+void SID_flush ();
+void SID_poke_fast (uint8_t port, uint8_t data);
+void SID_hold ();
+void SID_replay ();
+void SID_refresh (uint8_t n);
+
+#ifdef SID_READBACK
+uint8_t SID_peek (uint8_t port);
+#endif
+
+#if SID_CHIPS > 1
+extern SIDshadow _shadow_2;
+extern uint8_t   _sid_mode;
+
+void SID_set_2 (uint8_t port, uint8_t data);
+void SID_mode (uint8_t mode);
+#endif
+
+/* Every write as it goes out on the bus, for 'make trace' */
+#ifdef SID_TRACE
+void sid_trace (uint8_t chip, uint8_t port, uint8_t data);
+#else
+#define sid_trace(chip, port, data)
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+/*
+  'SID GUTS' host tools - EEPROM stand-ins
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_HOST_AVR_EEPROM_H
+#define _HAVE_HOST_AVR_EEPROM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Declared only, a test that saves settings provides them */
+uint8_t eeprom_read_byte (const uint8_t *a);
+void    eeprom_update_byte (uint8_t *a, uint8_t v);
+void    eeprom_read_block (void *dst, const void *src, size_t n);
+void    eeprom_update_block (const void *src, void *dst, size_t n);
+
+#endif
@@ -0,0 +1,38 @@
+/*
+  'SID GUTS' host tools - program space stand-ins
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_HOST_AVR_PGMSPACE_H
+#define _HAVE_HOST_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+/* One address space on the host */
+#define PROGMEM
+#define PGM_P              const char *
+#define PSTR(s)            (s)
+#define pgm_read_byte(a)   (*(const uint8_t *)(a))
+#define pgm_read_word(a)   (*(const uint16_t *)(a))
+#define pgm_read_dword(a)  (*(const uint32_t *)(a))
+#define pgm_read_ptr(a)    (*(void * const *)(a))
+#define memcpy_P           memcpy
+
+#endif
@@ -0,0 +1,101 @@
+/*
+  'SID GUTS' host tool - CV quantiser test
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Host test for quant.c. Readings go through quant_cv() in order, so
+ * the hysteresis carries from one to the next until the scale changes.
+ * Built with a user scale that leaves out its root, to cover the
+ * nearest degree falling below 0V.
+ *
+ *   make quanttest
+ */
+#include "uu.h"
+#include "quant.h"
+#include <stdio.h>
+
+#define AS_READ -1
+
+typedef struct _Step
+{
+  uint8_t scale;
+  int     cv;
+  int8_t  note;   /* expected, semitones above 0V */
+} Step;
+
+static const Step script[] = {
+  { QUANT_OFF,        300,  AS_READ },
+
+  /* Hysteresis, 17.07 counts a semitone, a new note 0.75 past centre */
+  { QUANT_CHROMATIC,  85,   5 },
+  { QUANT_CHROMATIC,  98,   5 },
+  { QUANT_CHROMATIC,  99,   6 },
+  { QUANT_CHROMATIC,  90,   6 },
+  { QUANT_CHROMATIC,  89,   5 },
+  { QUANT_CHROMATIC,  1023, 60 },  /* top, clamped to 1023 */
+
+  { QUANT_MAJOR,      17,   0 },
+  { QUANT_MAJOR,      102,  5 },   /* tie between 5 and 7 goes down */
+  { QUANT_MAJOR,      188,  11 },
+  { QUANT_MAJOR,      222,  12 },
+
+  { QUANT_PENTATONIC, 68,   4 },
+  { QUANT_PENTATONIC, 102,  7 },   /* 7 a semitone off, 4 two */
+
+  /* 0x4a8, no root. 0V's nearest is a whole tone below, which can't be
+     played; the lowest degree there is, not the top of the octave */
+  { QUANT_USER,       0,    3 },
+  { QUANT_USER,       17,   3 },
+  { QUANT_USER,       205,  10 },  /* an octave up the one below is fine */
+};
+
+#define STEPS (sizeof(script) / sizeof(script[0]))
+
+int
+main (void)
+{
+  Quant   q;
+  uint8_t i, scale = 0xff;
+  int     got, want, failed = 0;
+
+  for (i = 0; i < STEPS; i++)
+    {
+      if (script[i].scale != scale)
+	{
+	  scale = script[i].scale;
+	  quant_init(&q, scale);
+	}
+
+      got  = quant_cv(&q, script[i].cv);
+      want = script[i].note == AS_READ ? script[i].cv
+	: MIN((script[i].note * 273 + 8) >> 4, 1023);
+
+      if (got != want)
+	{
+	  printf("step %u: scale %u cv %d gave %d, wanted %d\n",
+		 i, scale, script[i].cv, got, want);
+	  failed++;
+	}
+    }
+
+  printf("quanttest: %u steps, %d failed\n", (unsigned)STEPS, failed);
+
+  return failed != 0;
+}
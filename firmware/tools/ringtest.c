@@ -0,0 +1,254 @@
+/*
+  'SID GUTS' host tool - ring buffer stress test
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Host stress test for uu_ring.c. A SIGALRM handler on a fast interval
+ * timer plays the interrupt: it preempts the main loop at arbitrary
+ * points, like Timer2 does, and runs to completion before the main loop
+ * carries on. Each run pushes a counting sequence from one side and
+ * checks on the other that nothing is lost, repeated or out of order.
+ * Every element size and the bulk calls are run, in both directions.
+ *
+ *   make ringtest
+ */
+#include "uu.h"
+#include "uu_ring.h"
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define ITEMS    30000 /* per run */
+#define TIMER_US 20
+#define BURST    5     /* most elements moved per main loop call */
+#define DAWDLE   8192  /* most spins between main loop calls */
+
+#define BYTES    1
+#define WORDS    2
+#define LONGS    4
+#define BULK     0     /* bulk calls on 2 byte elements */
+
+static UUring            _ring;
+static uint32_t          _buf[16];
+
+static uint8_t           _kind;
+static volatile bool     _isr_producer;
+static volatile uint32_t _isr_seq;   /* next to push or expected pop */
+static volatile uint32_t _isr_bad;
+static volatile bool     _done;
+static uint32_t          _rand = 0x5eed;
+
+/* 1..n */
+static uint16_t
+upto (uint16_t n)
+{
+  _rand ^= _rand << 13;
+  _rand ^= _rand >> 17;
+  _rand ^= _rand << 5;
+
+  return 1 + _rand % n;
+}
+
+/* Random work between main loop calls, up to about a timer period. A
+   main loop that outruns the interrupt sits on a full or empty ring and
+   only moves straight after it, so it is never caught mid push or pop */
+static void
+dawdle (void)
+{
+  volatile uint16_t n = upto(DAWDLE);
+
+  while (n--)
+    ;
+}
+
+/* One element, truncated to the run's size. FALSE if the ring was full */
+static bool
+push (uint32_t seq)
+{
+  switch (_kind)
+    {
+    case BYTES: return uu_ring8_push(&_ring, seq);
+    case WORDS: return uu_ring16_push(&_ring, seq);
+    case LONGS: return uu_ring32_push(&_ring, seq);
+    }
+
+  return FALSE;
+}
+
+/* FALSE if the ring was empty */
+static bool
+pop (uint32_t *v)
+{
+  uint8_t  b;
+  uint16_t w;
+  bool     ok = FALSE;
+
+  switch (_kind)
+    {
+    case BYTES: ok = uu_ring8_pop(&_ring, &b); *v = b; break;
+    case WORDS: ok = uu_ring16_pop(&_ring, &w); *v = w; break;
+    case LONGS: ok = uu_ring32_pop(&_ring, v); break;
+    }
+
+  return ok;
+}
+
+static uint32_t
+wrap (uint32_t seq)
+{
+  return _kind == LONGS ? seq : seq & ((1UL << (8 * (_kind ? _kind : 2))) - 1);
+}
+
+/* Push up to n of the sequence from *seq on, returns how many went */
+static uint8_t
+produce (uint32_t *seq, uint8_t n)
+{
+  uint16_t run[16];
+  uint8_t  i;
+
+  if (*seq + n > ITEMS)
+    n = ITEMS - *seq;
+
+  if (_kind != BULK)
+    {
+      for (i = 0; i < n && push(*seq); i++)
+	(*seq)++;
+      return i;
+    }
+
+  for (i = 0; i < n; i++)
+    run[i] = *seq + i;
+  n = uu_ring_push_bulk(&_ring, run, n);
+  *seq += n;
+
+  return n;
+}
+
+/* Pop up to n and check them against *seq, returns how many were bad */
+static uint32_t
+consume (uint32_t *seq, uint8_t n)
+{
+  uint16_t run[16];
+  uint32_t v, bad = 0;
+  uint8_t  i;
+
+  if (_kind != BULK)
+    {
+      for (i = 0; i < n && pop(&v); i++)
+	bad += v != wrap((*seq)++);
+      return bad;
+    }
+
+  n = uu_ring_pop_bulk(&_ring, run, n);
+  for (i = 0; i < n; i++)
+    bad += run[i] != wrap((*seq)++);
+
+  return bad;
+}
+
+static void
+isr (int sig)
+{
+  uint32_t seq = _isr_seq;
+
+  if (_isr_producer)
+    produce(&seq, upto(_ring.mask + 1));
+  else
+    _isr_bad += consume(&seq, upto(_ring.mask + 1));
+
+  _isr_seq = seq;
+  if (seq >= ITEMS && !_isr_producer)
+    _done = TRUE;
+}
+
+static uint32_t
+run (const char *name, uint8_t kind, uint8_t capacity, bool isr_producer)
+{
+  struct itimerval t = { { 0, TIMER_US }, { 0, TIMER_US } };
+  struct itimerval off;
+  uint32_t         seq = 0, bad = 0;
+
+  memset(&off, 0, sizeof(off));
+  uu_ring_init(&_ring, _buf, capacity, kind == BULK ? 2 : kind);
+  _kind         = kind;
+  _isr_producer = isr_producer;
+  _isr_seq      = 0;
+  _isr_bad      = 0;
+  _done         = FALSE;
+  setitimer(ITIMER_REAL, &t, NULL);
+
+  /* The main loop side never blocks, it just keeps trying */
+  if (isr_producer)
+    while (seq < ITEMS)
+      {
+	bad += consume(&seq, upto(BURST));
+	dawdle();
+      }
+  else
+    {
+      while (seq < ITEMS)
+	{
+	  produce(&seq, upto(BURST));
+	  dawdle();
+	}
+      while (!_done)
+	;
+      bad = _isr_bad;
+    }
+
+  setitimer(ITIMER_REAL, &off, NULL);
+  if (!uu_ring_empty(&_ring))
+    bad++;
+
+  printf("%-6s %-4s -> %-4s cap %3u: %s\n", name,
+	 isr_producer ? "isr" : "main", isr_producer ? "main" : "isr",
+	 capacity, bad ? "FAIL" : "ok");
+
+  return bad;
+}
+
+int
+main (void)
+{
+  static const struct { const char *name; uint8_t kind; uint8_t cap; } runs[] = {
+    { "ring8",  BYTES, 16 },
+    { "ring8",  BYTES, 2 },
+    { "ring16", WORDS, 16 },
+    { "ring32", LONGS, 16 },
+    { "bulk",   BULK,  16 },
+    { "bulk",   BULK,  4 },
+  };
+  uint32_t failed = 0;
+  uint8_t  i;
+
+  signal(SIGALRM, isr);
+
+  for (i = 0; i < sizeof(runs) / sizeof(runs[0]); i++)
+    {
+      failed += !!run(runs[i].name, runs[i].kind, runs[i].cap, TRUE);
+      failed += !!run(runs[i].name, runs[i].kind, runs[i].cap, FALSE);
+    }
+
+  printf("ringtest: %u runs, %u failed\n",
+	 (unsigned)(2 * sizeof(runs) / sizeof(runs[0])), (unsigned)failed);
+
+  return failed != 0;
+}
@@ -0,0 +1,568 @@
+/*
+  'SID GUTS' host tool - trace to WAV
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Renders the register writes from a 'make trace' run to a mono 16 bit
+ * WAV, so control rate artefacts - zipper steps, glitches, glide - can
+ * be listened to without hardware. Writes land at their cycle
+ * timestamps on a model of one chip clocked at 1MHz: three oscillators
+ * with ring and sync, the envelopes, the state variable filter and the
+ * volume DC step that digi samples use. Close enough to A/B two builds,
+ * it is not a cycle exact 6581.
+ *
+ *   sidwav < sidguts.trace > sidguts.wav
+ *   sidwav -j 4 a.trace b.trace ...     a.wav b.wav ... 4 at a time
+ *
+ * -c picks the chip of a two chip trace.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define F_CPU     16000000
+#define SID_CLOCK 1000000
+#define WAV_RATE  44100
+#define WAV_TAIL  (WAV_RATE / 4) /* after the last write, for releases */
+
+#define CTRL_GATE     0x01
+#define CTRL_SYNC     0x02
+#define CTRL_RING     0x04
+#define CTRL_TEST     0x08
+#define CTRL_TRIANGLE 0x10
+#define CTRL_SAW      0x20
+#define CTRL_PULSE    0x40
+#define CTRL_NOISE    0x80
+
+#define MODE_LP       0x10
+#define MODE_BP       0x20
+#define MODE_HP       0x40
+#define MODE_3OFF     0x80
+
+#define ACC_MSB       0x800000
+#define NOISE_SEED    0x7ffff8
+
+#define CUTOFF_MIN    30.0    /* Hz at 0, linear up from there */
+#define CUTOFF_MAX    12000.0 /* at 2047 */
+#define DIGI_DC       0.4     /* mixer offset the volume scales */
+#define DC_BLOCK      0.9977  /* output coupling cap, ~16Hz */
+
+enum { ENV_ATTACK, ENV_DECAY, ENV_RELEASE };
+
+/* Cycles per envelope step for each rate nibble */
+static const uint16_t env_period[16] = {
+  9, 32, 63, 95, 149, 220, 267, 313, 392, 977, 1954, 3126, 3907,
+  11720, 19532, 31251
+};
+
+typedef struct _Voice
+{
+  uint32_t acc;   /* 24 bit phase */
+  uint32_t lfsr;  /* 23 bit noise */
+  uint16_t freq;
+  uint16_t pw;    /* 12 bit */
+  uint8_t  ctrl;
+  uint8_t  ad;
+  uint8_t  sr;
+  uint8_t  msb_rose;
+
+  uint8_t  env;   /* level */
+  uint8_t  state;
+  uint16_t count; /* cycles into this step */
+  uint8_t  exp;   /* steps into the exponential divide */
+} Voice;
+
+typedef struct _Sid
+{
+  Voice   voice[3];
+  uint8_t regs[25];
+
+  double  g, k, a1, a2, a3; /* filter, from cutoff and resonance */
+  double  ic1, ic2;
+  double  dc_in, dc_out;
+} Sid;
+
+typedef struct _Write
+{
+  uint32_t clock; /* SID cycles */
+  uint8_t  reg;
+  uint8_t  value;
+} Write;
+
+static void
+put16 (FILE *f, uint16_t v)
+{
+  putc(v & 0xff, f);
+  putc(v >> 8, f);
+}
+
+static void
+put32 (FILE *f, uint32_t v)
+{
+  put16(f, v & 0xffff);
+  put16(f, v >> 16);
+}
+
+static void
+wav_header (FILE *f, uint32_t samples)
+{
+  fwrite("RIFF", 1, 4, f);
+  put32(f, 36 + samples * 2);
+  fwrite("WAVEfmt ", 1, 8, f);
+  put32(f, 16);
+  put16(f, 1);             /* PCM */
+  put16(f, 1);             /* mono */
+  put32(f, WAV_RATE);
+  put32(f, WAV_RATE * 2);
+  put16(f, 2);
+  put16(f, 16);
+  fwrite("data", 1, 4, f);
+  put32(f, samples * 2);
+}
+
+static void
+filter_set (Sid *s)
+{
+  unsigned fc  = (s->regs[22] << 3) | (s->regs[21] & 7);
+  unsigned res = s->regs[23] >> 4;
+  double   hz  = CUTOFF_MIN + (CUTOFF_MAX - CUTOFF_MIN) * fc / 2047.0;
+
+  /* Q from 0.7 to about 4 */
+  s->k  = 1.0 / (0.707 + res * (4.0 - 0.707) / 15.0);
+  s->g  = tan(M_PI * hz / WAV_RATE);
+  s->a1 = 1.0 / (1.0 + s->g * (s->g + s->k));
+  s->a2 = s->g * s->a1;
+  s->a3 = s->g * s->a2;
+}
+
+static void
+sid_reset (Sid *s)
+{
+  int v;
+
+  memset(s, 0, sizeof(*s));
+  for (v = 0; v < 3; v++)
+    {
+      s->voice[v].lfsr  = NOISE_SEED;
+      s->voice[v].state = ENV_RELEASE;
+    }
+  filter_set(s);
+}
+
+static void
+sid_write (Sid *s, uint8_t reg, uint8_t value)
+{
+  Voice  *v;
+  uint8_t was;
+
+  if (reg >= sizeof(s->regs))
+    return;
+
+  s->regs[reg] = value;
+
+  if (reg >= 21)
+    {
+      filter_set(s);
+      return;
+    }
+
+  v = &s->voice[reg / 7];
+  switch (reg % 7)
+    {
+    case 0: v->freq = (v->freq & 0xff00) | value; break;
+    case 1: v->freq = (v->freq & 0x00ff) | (value << 8); break;
+    case 2: v->pw = (v->pw & 0x0f00) | value; break;
+    case 3: v->pw = (v->pw & 0x00ff) | ((value & 0x0f) << 8); break;
+    case 4:
+      was = v->ctrl;
+      v->ctrl = value;
+      if ((value & CTRL_GATE) && !(was & CTRL_GATE))
+	v->state = ENV_ATTACK;
+      else if (!(value & CTRL_GATE) && (was & CTRL_GATE))
+	v->state = ENV_RELEASE;
+      if (value & CTRL_TEST)
+	{
+	  v->acc  = 0;
+	  v->lfsr = NOISE_SEED;
+	}
+      break;
+    case 5: v->ad = value; break;
+    case 6: v->sr = value; break;
+    }
+}
+
+/* Steps of the rate counter before the level moves, the exponential
+   look of decay and release */
+static uint8_t
+env_divide (uint8_t level)
+{
+  if (level >= 93) return 1;
+  if (level >= 54) return 2;
+  if (level >= 26) return 4;
+  if (level >= 14) return 8;
+  if (level >= 6)  return 16;
+  return 30;
+}
+
+static void
+env_clock (Voice *v, uint32_t delta)
+{
+  uint16_t period;
+  uint32_t left;
+  uint8_t  sustain = (v->sr >> 4) * 0x11;
+
+  while (delta)
+    {
+      /* Parked, nothing to count towards */
+      if ((v->state == ENV_DECAY && v->env <= sustain)
+	  || (v->state == ENV_RELEASE && v->env == 0))
+	return;
+
+      switch (v->state)
+	{
+	case ENV_ATTACK: period = env_period[v->ad >> 4]; break;
+	case ENV_DECAY:  period = env_period[v->ad & 0x0f]; break;
+	default:         period = env_period[v->sr & 0x0f]; break;
+	}
+
+      left = (v->count < period) ? period - v->count : 1;
+      if (delta < left)
+	{
+	  v->count += delta;
+	  return;
+	}
+      delta   -= left;
+      v->count = 0;
+
+      if (v->state == ENV_ATTACK)
+	{
+	  if (v->env == 0xff || ++v->env == 0xff)
+	    v->state = ENV_DECAY;
+	  v->exp = 0;
+	}
+      else if (++v->exp >= env_divide(v->env))
+	{
+	  v->exp = 0;
+	  v->env--;
+	}
+    }
+}
+
+static void
+osc_clock (Voice *v, uint32_t delta)
+{
+  uint32_t from = v->acc, to, n;
+
+  if (v->ctrl & CTRL_TEST)
+    {
+      v->msb_rose = 0;
+      return;
+    }
+
+  to = from + v->freq * delta;
+
+  /* Noise shifts on each rise of bit 19 */
+  n = ((to + 0x80000) >> 20) - ((from + 0x80000) >> 20);
+  while (n--)
+    v->lfsr = ((v->lfsr << 1) | (((v->lfsr >> 22) ^ (v->lfsr >> 17)) & 1))
+      & 0x7fffff;
+
+  v->acc      = to & 0xffffff;
+  v->msb_rose = !(from & ACC_MSB) && (v->acc & ACC_MSB);
+}
+
+/* 12 bit waveform, selected waveforms combined by AND */
+static unsigned
+osc_output (Sid *s, int i)
+{
+  Voice   *v   = &s->voice[i];
+  Voice   *src = &s->voice[(i + 2) % 3]; /* ring and sync source */
+  unsigned out = 0xfff, msb, l = v->lfsr;
+
+  if (!(v->ctrl & 0xf0))
+    return 0x800;
+
+  if (v->ctrl & CTRL_TRIANGLE)
+    {
+      msb = v->acc & ACC_MSB;
+      if (v->ctrl & CTRL_RING)
+	msb ^= src->acc & ACC_MSB;
+      out &= ((msb ? ~v->acc : v->acc) >> 11) & 0xfff;
+    }
+  if (v->ctrl & CTRL_SAW)
+    out &= v->acc >> 12;
+  if (v->ctrl & CTRL_PULSE)
+    out &= ((v->acc >> 12) >= v->pw || (v->ctrl & CTRL_TEST)) ? 0xfff : 0;
+  if (v->ctrl & CTRL_NOISE)
+    out &= ((l >> 11) & 0x800) | ((l >> 10) & 0x400) | ((l >> 7) & 0x200)
+      | ((l >> 5) & 0x100) | ((l >> 4) & 0x080) | ((l >> 1) & 0x040)
+      | ((l << 1) & 0x020) | ((l << 2) & 0x010);
+
+  return out;
+}
+
+static void
+sid_clock (Sid *s, uint32_t delta)
+{
+  int i;
+
+  if (!delta)
+    return;
+
+  for (i = 0; i < 3; i++)
+    {
+      osc_clock(&s->voice[i], delta);
+      env_clock(&s->voice[i], delta);
+    }
+
+  /* Hard sync to the end of the step, close enough at audio rate */
+  for (i = 0; i < 3; i++)
+    if ((s->voice[i].ctrl & CTRL_SYNC) && s->voice[(i + 2) % 3].msb_rose)
+      s->voice[i].acc = 0;
+}
+
+/* One output sample, -1..1 */
+static double
+sid_output (Sid *s)
+{
+  double  x, filt = 0, dry = 0, in = 0, v1, v2, v3, out;
+  uint8_t route = s->regs[23], mode = s->regs[24];
+  int     i;
+
+  for (i = 0; i < 3; i++)
+    {
+      x = ((int)osc_output(s, i) - 0x800) / 2048.0 * s->voice[i].env / 255.0;
+      if (route & (1 << i))
+	in += x;
+      else if (i != 2 || !(mode & MODE_3OFF))
+	dry += x;
+    }
+
+  /* Topology preserving state variable filter */
+  v3 = in - s->ic2;
+  v1 = s->a1 * s->ic1 + s->a2 * v3;
+  v2 = s->ic2 + s->a2 * s->ic1 + s->a3 * v3;
+  s->ic1 = 2 * v1 - s->ic1;
+  s->ic2 = 2 * v2 - s->ic2;
+
+  if (mode & MODE_LP)
+    filt += v2;
+  if (mode & MODE_BP)
+    filt += v1;
+  if (mode & MODE_HP)
+    filt += in - s->k * v1 - v2;
+
+  x = ((dry + filt) / 3.0 * 0.5 + DIGI_DC) * (mode & 0x0f) / 15.0;
+
+  out = x - s->dc_in + DC_BLOCK * s->dc_out;
+  s->dc_in  = x;
+  s->dc_out = out;
+
+  return out;
+}
+
+static Write *
+trace_read (FILE *in, unsigned want, size_t *count)
+{
+  char      line[128];
+  unsigned  chip, reg, value;
+  unsigned long long cycles;
+  Write    *w = NULL;
+  size_t    n = 0, size = 0;
+
+  while (fgets(line, sizeof(line), in))
+    {
+      if (sscanf(line, "trace,%llu,%u,%u,%u",
+		 &cycles, &chip, &reg, &value) != 4
+	  || chip != want)
+	continue;
+
+      if (n == size)
+	{
+	  size = size ? size * 2 : 1024;
+	  w = realloc(w, size * sizeof(*w));
+	  if (!w)
+	    return NULL;
+	}
+      w[n].clock = cycles / (F_CPU / SID_CLOCK);
+      w[n].reg   = reg;
+      w[n].value = value;
+      n++;
+    }
+
+  *count = n;
+
+  return w ? w : malloc(sizeof(*w));
+}
+
+static int
+render (FILE *in, FILE *out, unsigned chip)
+{
+  Sid       sid;
+  Write    *w;
+  int16_t  *pcm;
+  size_t    n, i = 0, k, samples;
+  uint32_t  clock = 0, at;
+  double    x;
+
+  w = trace_read(in, chip, &n);
+  if (!w)
+    return 1;
+
+  samples = n ? (size_t)((uint64_t)w[n - 1].clock * WAV_RATE / SID_CLOCK)
+    + WAV_TAIL : 0;
+  pcm = malloc((samples + 1) * sizeof(*pcm));
+  if (!pcm)
+    {
+      free(w);
+      return 1;
+    }
+
+  sid_reset(&sid);
+
+  /* Run to each sample point, taking the writes due before it */
+  for (k = 0; k < samples; k++)
+    {
+      at = (uint64_t)(k + 1) * SID_CLOCK / WAV_RATE;
+      for (; i < n && w[i].clock <= at; i++)
+	{
+	  sid_clock(&sid, w[i].clock - clock);
+	  clock = w[i].clock;
+	  sid_write(&sid, w[i].reg, w[i].value);
+	}
+      sid_clock(&sid, at - clock);
+      clock = at;
+
+      x = sid_output(&sid) * 32767.0;
+      pcm[k] = x > 32767 ? 32767 : x < -32768 ? -32768 : (int16_t)x;
+    }
+
+  wav_header(out, samples);
+  for (k = 0; k < samples; k++)
+    put16(out, (uint16_t)pcm[k]);
+
+  free(pcm);
+  free(w);
+
+  return ferror(out) ? 1 : 0;
+}
+
+/* name.trace to name.wav */
+static int
+render_file (const char *name, unsigned chip)
+{
+  char  wav[1024];
+  char *dot;
+  FILE *in, *out;
+  int   r;
+
+  snprintf(wav, sizeof(wav) - 4, "%s", name);
+  dot = strrchr(wav, '.');
+  if (dot && !strchr(dot, '/'))
+    *dot = 0;
+  strcat(wav, ".wav");
+
+  in = fopen(name, "r");
+  if (!in)
+    {
+      perror(name);
+      return 1;
+    }
+  out = fopen(wav, "wb");
+  if (!out)
+    {
+      perror(wav);
+      fclose(in);
+      return 1;
+    }
+
+  r = render(in, out, chip);
+  fclose(in);
+  if (fclose(out))
+    r = 1;
+  if (r)
+    fprintf(stderr, "sidwav: %s failed\n", name);
+
+  return r;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned chip = 0;
+  int      jobs = 1, running = 0, failed = 0, status, c;
+
+  while ((c = getopt(argc, argv, "j:c:")) != -1)
+    switch (c)
+      {
+      case 'j': jobs = atoi(optarg); break;
+      case 'c': chip = atoi(optarg); break;
+      default:
+	fprintf(stderr, "usage: sidwav [-c chip] [-j jobs] [trace...]\n");
+	return 1;
+      }
+
+  if (optind == argc)
+    return render(stdin, stdout, chip);
+
+  if (jobs < 1)
+    jobs = 1;
+
+  /* A process per trace, up to jobs at once */
+  for (; optind < argc; optind++)
+    {
+      if (jobs == 1)
+	{
+	  failed |= render_file(argv[optind], chip);
+	  continue;
+	}
+
+      if (running == jobs)
+	{
+	  wait(&status);
+	  failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+	  running--;
+	}
+
+      switch (fork())
+	{
+	case -1:
+	  perror("sidwav");
+	  failed = 1;
+	  break;
+	case 0:
+	  _exit(render_file(argv[optind], chip));
+	default:
+	  running++;
+	}
+    }
+
+  while (running--)
+    {
+      wait(&status);
+      failed |= !WIFEXITED(status) || WEXITSTATUS(status);
+    }
+
+  return failed;
+}
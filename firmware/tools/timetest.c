@@ -0,0 +1,126 @@
+/*
+  'SID GUTS' host tool - timer wheel test
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Host test for the uu_time.c timer wheel, callbacks that start and
+ * cancel timers in the slot being run. The clock is stepped by calling
+ * uu_time_tick() directly. A wheel left in a loop hangs uu_time_run(),
+ * so SIGALRM fails the test after a second.
+ *
+ *   make timetest
+ */
+#include "uu.h"
+#include "uu_time.h"
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define TIMERS 3
+
+volatile uint8_t SREG;
+
+static UUtimer  _t[TIMERS];
+static unsigned _fired[TIMERS];
+static int      _failed;
+
+/* Step the clock on to ms */
+static void
+run_to (uint32_t ms)
+{
+  while (uu_time_ms() < ms)
+    uu_time_tick();
+
+  uu_time_run();
+}
+
+static void
+check (const char *what, unsigned got, unsigned want)
+{
+  if (got != want)
+    {
+      printf("timetest: %s %u, wanted %u\n", what, got, want);
+      _failed++;
+    }
+}
+
+static void
+hung (int sig)
+{
+  static const char msg[] = "timetest: uu_time_run() never returned\n";
+
+  fflush(stdout);
+  write(1, msg, sizeof(msg) - 1);
+  _exit(1);
+}
+
+static void
+count (void *arg)
+{
+  _fired[(UUtimer *)arg - _t]++;
+}
+
+/* Cancels timer 0, which is ahead of it in the slot */
+static void
+cancel_0 (void *arg)
+{
+  count(arg);
+  uu_timer_cancel(&_t[0]);
+}
+
+/* Due again straight away */
+static void
+again (void *arg)
+{
+  count(arg);
+  uu_timer_start(arg, 0, again, arg);
+}
+
+int
+main (void)
+{
+  signal(SIGALRM, hung);
+  alarm(1);
+
+  /* Started last is first in the slot: 0 (not due), 1 (cancels 0), 2 */
+  uu_timer_start(&_t[2], 5, count, &_t[2]);
+  uu_timer_start(&_t[1], 5, cancel_0, &_t[1]);
+  uu_timer_start(&_t[0], 10, count, &_t[0]);
+  run_to(6);
+  check("cancelled in the walk, armed", uu_timer_armed(&_t[0]), FALSE);
+  check("after the cancel, fired", _fired[2], 1);
+
+  /* Timer 2 must really have left the slot to go back in it */
+  uu_timer_start(&_t[2], 3, count, &_t[2]);
+  run_to(12);
+  check("restarted, fired", _fired[2], 2);
+  check("cancelled, fired", _fired[0], 0);
+
+  /* 0ms from its own callback waits for the next run */
+  uu_timer_start(&_t[0], 1, again, &_t[0]);
+  run_to(13);
+  run_to(14);
+  run_to(15);
+  check("restarted at 0ms, fired", _fired[0], 3);
+
+  printf("timetest: %d failed\n", _failed);
+
+  return _failed != 0;
+}
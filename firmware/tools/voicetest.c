@@ -0,0 +1,164 @@
+/*
+  'SID GUTS' host tool - voice allocator test
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+/*
+ * Host test for voice.c. Scripted note streams go through the real
+ * allocator and hard restart (voice.c, gate.c). The SID is a register
+ * image, so each event is checked for the voice it lands on and the
+ * register writes it costs on the bus. Every restart runs to completion
+ * before the next event.
+ *
+ *   make voicetest
+ */
+#include "uu.h"
+#include "sid.h"
+#include "gate.h"
+#include "voice.h"
+#include <stdio.h>
+
+#define ON   0
+#define OFF  1
+#define INIT 2 /* note is the allocation mode */
+
+#define WAVE 0x20 /* saw */
+#define AD   0x09
+#define SR   0xf0
+
+/* Longest a restart can take */
+#ifdef GATE_HR_US
+#define RESTART_TICKS GATE_HR_TICKS
+#else
+#define RESTART_TICKS GATE_HR_SHORT_TICKS
+#endif
+
+typedef struct _Step
+{
+  uint8_t event;
+  uint8_t note;
+  int8_t  voice;  /* expected, -1 for a note off that wasn't sounding */
+  uint8_t writes; /* expected bus writes, restart included */
+} Step;
+
+static const Step script[] = {
+  /* Round robin, the fourth note steals the next in turn */
+  { INIT, VOICE_ROUND_ROBIN, 0, 0 },
+  { ON,   60, 0, 8 },  /* freq lo/hi, restart AD/SR/test, AD/SR/gate */
+  { ON,   64, 1, 8 },
+  { ON,   67, 2, 8 },
+  { ON,   72, 0, 8 },  /* steal */
+  { OFF,  64, 1, 1 },
+  { ON,   76, 1, 8 },  /* free one, next in turn anyway */
+  { OFF,  65, -1, 0 }, /* never played */
+  { ON,   72, 0, 6 },  /* retrigger, same voice, no frequency writes */
+  { OFF,  72, 0, 1 },
+  { OFF,  76, 1, 1 },
+  { OFF,  67, 2, 1 },
+
+  /* Last note, a stolen note comes back when the thief is released */
+  { INIT, VOICE_LAST_NOTE, 0, 0 },
+  { ON,   48, 0, 8 },
+  { ON,   52, 1, 8 },
+  { ON,   55, 2, 8 },
+  { ON,   59, 0, 8 },  /* oldest, 48, loses its voice */
+  { OFF,  59, 0, 8 },  /* 48 is still held, gets it back */
+  { OFF,  52, 1, 1 },
+  { ON,   62, 1, 8 },  /* the free voice */
+  { OFF,  48, 0, 1 },
+  { OFF,  55, 2, 1 },
+  { OFF,  62, 1, 1 },
+  { ON,   62, 0, 8 },  /* all free, the one released longest ago */
+};
+
+#define SCRIPT_N (sizeof(script)/sizeof(Step))
+
+SIDshadow        _shadow;
+volatile uint8_t SREG;
+
+static unsigned _writes;
+
+/* Only changed registers go out, as SID_flush() would send them */
+void
+SID_set (uint8_t port, uint8_t data)
+{
+  if (_shadow.regs[port] == data)
+    return;
+
+  _shadow.regs[port] = data;
+  _writes++;
+}
+
+void
+SID_poke (uint8_t port, uint8_t data)
+{
+  _shadow.regs[port] = data;
+  _writes++;
+}
+
+void
+SID_poke_fast (uint8_t port, uint8_t data)
+{
+  SID_set(port, data);
+}
+
+int
+main ()
+{
+  const Step *s;
+  unsigned    i, t, failed = 0;
+  int         v = 0;
+
+  for (i = 0; i < SCRIPT_N; i++)
+    {
+      s = &script[i];
+      _writes = 0;
+
+      switch (s->event)
+	{
+	case INIT:
+	  voice_init(s->note);
+	  voice_patch(WAVE, AD, SR, 2048);
+	  v = 0;
+	  break;
+	case ON:
+	  v = voice_note_on(s->note);
+	  break;
+	case OFF:
+	  v = voice_note_off(s->note);
+	  break;
+	}
+
+      /* Timer2 until the restart is done */
+      for (t = 0; t < RESTART_TICKS + 2; t++)
+	gate_tick();
+
+      if (s->event != INIT && (v != s->voice || _writes != s->writes))
+	{
+	  printf("voicetest: step %u %s %u: voice %d writes %u,"
+		 " wanted %d and %u\n", i, s->event == ON ? "on" : "off",
+		 s->note, v, _writes, s->voice, s->writes);
+	  failed++;
+	}
+    }
+
+  printf("voicetest: %u steps, %u failed\n", (unsigned)SCRIPT_N, failed);
+
+  return failed ? 1 : 0;
+}
@@ -94,12 +94,6 @@
 #define TRUE  0x1
 #define FALSE 0x0
 
-#define PI 3.1415926535897932384626433832795
-#define HALF_PI 1.5707963267948966192313216916398
-#define TWO_PI 6.283185307179586476925286766559
-#define DEG_TO_RAD 0.017453292519943295769236907684886
-#define RAD_TO_DEG 57.295779513082320876798154814105
-
 #define SERIAL  0x0
 #define DISPLAY 0x1
 
@@ -114,9 +108,6 @@
 #define MAX(a,b) ((a)>(b)?(a):(b))
 #define ABS(x) ((x)>0?(x):-(x))
 #define CONSTRAIN(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
-#define ROUND(x)     ((x)>=0?(long)((x)+0.5):(long)((x)-0.5))
-#define RADIANS(deg) ((deg)*DEG_TO_RAD)
-#define DEGREES(rad) ((rad)*RAD_TO_DEG)
 #define SQ(x) ((x)*(x))
 
 extern const uint8_t PROGMEM digital_pin_table_PGM[];
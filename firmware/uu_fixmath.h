@@ -0,0 +1,68 @@
+/*
+  'UU' - Small AVR utility lib, fixed point maths
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_UU_FIXMATH_H
+#define _HAVE_UU_FIXMATH_H
+
+#include <stdint.h>
+
+/*
+ * Integer maths for the control path, no float and no libm. Multiplies
+ * are written so avr-gcc emits MUL/MULS/MULSU directly rather than
+ * calling the 32 bit library routines. Cycle counts are for the ATmega
+ * at -Os once inlined, not counting moving arguments into place.
+ */
+
+/* Clamp into a register sized value, ~5 cycles */
+static inline uint8_t
+uu_clamp_u8 (int16_t v)
+{
+  return (v < 0) ? 0 : (v > 0xff) ? 0xff : v;
+}
+
+/* 8x8 -> 16, one MUL/MULS/MULSU, 2 cycles + clearing r1 */
+static inline uint16_t
+uu_mul_u8 (uint8_t a, uint8_t b)
+{
+  return (uint16_t)a * b;
+}
+
+static inline int16_t
+uu_mul_s8 (int8_t a, int8_t b)
+{
+  return (int16_t)a * b;
+}
+
+static inline int16_t
+uu_mul_s8u8 (int8_t a, uint8_t b)
+{
+  return (int16_t)a * b;
+}
+
+/* 16x8 -> 24 (in 32), two MULs and an add, ~10 cycles against ~60 for
+   a full 32 bit multiply */
+static inline uint32_t
+uu_mul_u16u8 (uint16_t a, uint8_t b)
+{
+  return ((uint32_t)uu_mul_u8(a >> 8, b) << 8) + uu_mul_u8(a, b);
+}
+
+#endif
@@ -0,0 +1,116 @@
+/*
+  'UU' - Small AVR utility lib, key events
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "uu.h"
+#include "uu_time.h"
+#include "uu_keys.h"
+
+static void
+uu_keys_post (UUkeys *k, uint8_t type, uint8_t keys, uint32_t ms)
+{
+  UUkeyEvent e;
+
+  e.ms   = ms;
+  e.type = type;
+  e.keys = keys;
+  e.n    = k->n;
+
+  uu_ring_push_bulk(&k->events, &e, 1); /* dropped if nobody is reading */
+}
+
+/* Keys already down at start up don't count as pressed */
+void
+uu_keys_init (UUkeys *k, uint8_t raw)
+{
+  k->raw    = raw;
+  k->down   = raw;
+  k->steady = 0;
+  k->n      = 0;
+  k->due    = 0;
+
+  uu_ring_init(&k->events, k->buf, UU_KEYS_EVENTS, sizeof(UUkeyEvent));
+}
+
+void
+uu_keys_scan (UUkeys *k, uint8_t raw, uint32_t ms)
+{
+  uint8_t went_down, went_up, changed, key;
+
+  if (raw != k->raw)
+    {
+      k->raw    = raw;
+      k->steady = 0;
+    }
+  if (k->steady < 0xff)
+    k->steady++;
+
+  went_down = raw & ~k->down;
+  went_up   = k->down & ~raw;
+
+  if (went_down && k->steady < UU_KEYS_PRESS_SCANS)
+    went_down = 0;
+  if (went_up && k->steady < UU_KEYS_RELEASE_SCANS)
+    went_up = 0;
+
+  changed = went_down | went_up;
+
+  for (key = 1; went_up; key <<= 1)
+    if (went_up & key)
+      {
+	went_up &= ~key;
+	k->down &= ~key;
+	uu_keys_post(k, UU_KEY_RELEASE, key, ms);
+      }
+
+  if (went_down)
+    {
+      k->down |= went_down;
+
+      if (k->down == went_down && !(went_down & (went_down - 1)))
+	uu_keys_post(k, UU_KEY_PRESS, went_down, ms);
+      else
+	uu_keys_post(k, UU_KEY_CHORD, k->down, ms);
+    }
+
+  /* Any change starts the hold over */
+  if (changed || k->down != raw || !k->down)
+    {
+      k->n        = 0;
+      k->interval = UU_KEYS_REPEAT_MS;
+      k->due      = ms + UU_KEYS_LONG_MS;
+      return;
+    }
+
+  if (!uu_time_reached(ms, k->due))
+    return;
+
+  if (k->n == 0)
+    uu_keys_post(k, UU_KEY_LONG, k->down, ms);
+
+  if (k->n < 0xff)
+    k->n++;
+  uu_keys_post(k, UU_KEY_REPEAT, k->down, ms);
+
+  k->due = ms + k->interval;
+  k->interval -= k->interval >> UU_KEYS_ACCEL_SHIFT;
+  if (k->interval < UU_KEYS_REPEAT_MIN_MS)
+    k->interval = UU_KEYS_REPEAT_MIN_MS;
+}
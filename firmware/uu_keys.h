@@ -0,0 +1,97 @@
+/*
+  'UU' - Small AVR utility lib, key events
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_UU_KEYS_H
+#define _HAVE_UU_KEYS_H
+
+#include <stdint.h>
+#include "uu_ring.h"
+
+/*
+ * Key events from a polled mask of up to 8 keys. The caller scans at
+ * whatever rate it likes and hands over the raw mask with a uu_time
+ * timestamp; events queue up for uu_keys_event().
+ *
+ * A press or release only counts once the keys have read steady for
+ * UU_KEYS_PRESS_SCANS or UU_KEYS_RELEASE_SCANS, so contact bounce
+ * doesn't come back as a second press, or a glitch as a first. A key going down on its own
+ * is a PRESS, going down while others are held (or with them in the
+ * same scan) is a CHORD of the whole set. A set held past
+ * UU_KEYS_LONG_MS gives LONG, then REPEATs whose interval shrinks to
+ * UU_KEYS_REPEAT_MIN_MS; n counts them so the caller can take bigger
+ * steps too.
+ */
+
+#ifndef UU_KEYS_PRESS_SCANS
+#define UU_KEYS_PRESS_SCANS   2
+#endif
+#ifndef UU_KEYS_RELEASE_SCANS
+#define UU_KEYS_RELEASE_SCANS 2
+#endif
+#ifndef UU_KEYS_LONG_MS
+#define UU_KEYS_LONG_MS       500
+#endif
+#ifndef UU_KEYS_REPEAT_MS
+#define UU_KEYS_REPEAT_MS     200
+#endif
+#ifndef UU_KEYS_REPEAT_MIN_MS
+#define UU_KEYS_REPEAT_MIN_MS 20
+#endif
+#define UU_KEYS_ACCEL_SHIFT   2  /* each repeat a quarter quicker */
+#define UU_KEYS_EVENTS        8  /* queued, power of two */
+
+#define UU_KEY_PRESS   0
+#define UU_KEY_RELEASE 1
+#define UU_KEY_CHORD   2
+#define UU_KEY_LONG    3
+#define UU_KEY_REPEAT  4
+
+typedef struct _UUKeyEvent
+{
+  uint32_t ms;     /* scan it came from */
+  uint8_t  type;
+  uint8_t  keys;   /* the key, or the whole set for CHORD/LONG/REPEAT */
+  uint8_t  n;      /* REPEAT count, from 1 */
+} UUkeyEvent;
+
+typedef struct _UUKeys
+{
+  uint8_t    raw;       /* last scan */
+  uint8_t    down;      /* debounced */
+  uint8_t    steady;    /* scans raw has stayed the same */
+  uint8_t    n;
+  uint16_t   interval;
+  uint32_t   due;       /* next LONG/REPEAT */
+  UUring     events;
+  UUkeyEvent buf[UU_KEYS_EVENTS];
+} UUkeys;
+
+void
+uu_keys_init (UUkeys *k, uint8_t raw);
+
+void
+uu_keys_scan (UUkeys *k, uint8_t raw, uint32_t ms);
+
+#define uu_keys_event(k, e) uu_ring_pop_bulk(&(k)->events, (e), 1)
+#define uu_keys_pending(k)  (!uu_ring_empty(&(k)->events))
+#define uu_keys_down(k)     ((k)->down)
+
+#endif
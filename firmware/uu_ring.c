@@ -0,0 +1,81 @@
+/*
+  'UU' - Small AVR utility lib, ring buffers
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "uu.h"
+#include "uu_ring.h"
+#include <string.h>
+
+/* FALSE unless capacity is a power of two, 1..128 */
+bool
+uu_ring_init (UUring *r, void *buf, uint8_t capacity, uint8_t size)
+{
+  if (capacity == 0 || capacity > 128 || (capacity & (capacity - 1)))
+    return FALSE;
+
+  r->head = 0;
+  r->tail = 0;
+  r->mask = capacity - 1;
+  r->size = size;
+  r->buf  = buf;
+
+  return TRUE;
+}
+
+/* Copy n elements in, at most two runs either side of the wrap. Returns
+   how many fitted */
+uint8_t
+uu_ring_push_bulk (UUring *r, const void *src, uint8_t n)
+{
+  uint8_t head  = r->head;
+  uint8_t space = r->mask + 1 - (uint8_t)(head - r->tail);
+  uint8_t at    = head & r->mask;
+  uint8_t run;
+
+  n = MIN(n, space);
+  run = MIN(n, r->mask + 1 - at);
+
+  memcpy((uint8_t *)r->buf + at * r->size, src, run * r->size);
+  memcpy(r->buf, (const uint8_t *)src + run * r->size, (n - run) * r->size);
+  uu_ring_barrier();
+  r->head = head + n;
+
+  return n;
+}
+
+/* Copy up to n elements out, returns how many there were */
+uint8_t
+uu_ring_pop_bulk (UUring *r, void *dst, uint8_t n)
+{
+  uint8_t tail  = r->tail;
+  uint8_t count = r->head - tail;
+  uint8_t at    = tail & r->mask;
+  uint8_t run;
+
+  n = MIN(n, count);
+  run = MIN(n, r->mask + 1 - at);
+
+  memcpy(dst, (const uint8_t *)r->buf + at * r->size, run * r->size);
+  memcpy((uint8_t *)dst + run * r->size, r->buf, (n - run) * r->size);
+  uu_ring_barrier();
+  r->tail = tail + n;
+
+  return n;
+}
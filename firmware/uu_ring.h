@@ -0,0 +1,106 @@
+/*
+  'UU' - Small AVR utility lib, ring buffers
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_UU_RING_H
+#define _HAVE_UU_RING_H
+
+#include <stdint.h>
+
+/*
+ * Single producer, single consumer ring buffer, for passing data
+ * between an interrupt and the main loop without cli/sei. 8 bit head
+ * and tail run freely and are each written by one side only, a byte
+ * store being atomic on AVR. The element goes in before head moves
+ * and comes out before tail moves, so the other side never sees a
+ * half written one.
+ *
+ * Capacity is a power of two up to 128. Element sizes of 1, 2 and 4
+ * bytes get their own push/pop (uu_ring8_push() etc), the bulk calls
+ * take any size given at init.
+ *
+ *   uint16_t samples_buf[16];
+ *   UUring   samples;
+ *
+ *   uu_ring_init(&samples, samples_buf, 16, sizeof(uint16_t));
+ */
+
+typedef struct _UURing
+{
+  volatile uint8_t head;  /* producer only */
+  volatile uint8_t tail;  /* consumer only */
+  uint8_t          mask;  /* capacity - 1 */
+  uint8_t          size;  /* element bytes */
+  void            *buf;
+} UUring;
+
+bool
+uu_ring_init (UUring *r, void *buf, uint8_t capacity, uint8_t size);
+
+uint8_t
+uu_ring_push_bulk (UUring *r, const void *src, uint8_t n);
+
+uint8_t
+uu_ring_pop_bulk (UUring *r, void *dst, uint8_t n);
+
+/* Stop the compiler moving buffer accesses across index updates */
+#define uu_ring_barrier() __asm__ __volatile__ ("" ::: "memory")
+
+#define uu_ring_count(r) ((uint8_t)((r)->head - (r)->tail))
+#define uu_ring_empty(r) ((r)->head == (r)->tail)
+#define uu_ring_full(r)  (uu_ring_count(r) > (r)->mask)
+#define uu_ring_space(r) ((uint8_t)((r)->mask + 1 - uu_ring_count(r)))
+
+#define UU_RING_SIZED(bits, type)                                       \
+static inline bool                                                      \
+uu_ring##bits##_push (UUring *r, type v)                                \
+{                                                                       \
+  uint8_t head = r->head;                                               \
+									\
+  if ((uint8_t)(head - r->tail) > r->mask)                              \
+    return FALSE;                                                       \
+									\
+  ((type *)r->buf)[head & r->mask] = v;                                 \
+  uu_ring_barrier();                                                    \
+  r->head = head + 1;                                                   \
+									\
+  return TRUE;                                                          \
+}                                                                       \
+									\
+static inline bool                                                      \
+uu_ring##bits##_pop (UUring *r, type *v)                                \
+{                                                                       \
+  uint8_t tail = r->tail;                                               \
+									\
+  if (tail == r->head)                                                  \
+    return FALSE;                                                       \
+									\
+  *v = ((type *)r->buf)[tail & r->mask];                                \
+  uu_ring_barrier();                                                    \
+  r->tail = tail + 1;                                                   \
+									\
+  return TRUE;                                                          \
+}
+
+UU_RING_SIZED(8, uint8_t)
+UU_RING_SIZED(16, uint16_t)
+UU_RING_SIZED(32, uint32_t)
+
+#endif
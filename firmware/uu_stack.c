@@ -0,0 +1,82 @@
+/*
+  'UU' - Small AVR utility lib, stack usage
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "uu.h"
+#include "uu_stack.h"
+
+extern uint8_t _end;    /* first byte after .bss, from the linker */
+extern uint8_t __stack; /* RAMEND */
+
+/* Runs in .init1, before the stack pointer and r1 are set up, so no C
+   and nothing on the stack */
+void uu_stack_paint () __attribute__ ((naked, used, section (".init1")));
+
+void
+uu_stack_paint ()
+{
+  __asm__ __volatile__ (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:  st Z+, r24\n"
+    "2:  cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :: "M" (UU_STACK_PAINT));
+}
+
+/* Lowest address the stack has reached since it was painted */
+uint16_t
+uu_stack_low ()
+{
+  const uint8_t *p = &_end;
+
+  while (p <= &__stack && *p == UU_STACK_PAINT)
+    p++;
+
+  return (uint16_t)p;
+}
+
+/* Bytes between .bss and the deepest the stack has been */
+uint16_t
+uu_stack_free ()
+{
+  return uu_stack_low() - (uint16_t)&_end;
+}
+
+/* Paint again everything below the caller, ~4 cycles a byte. Interrupts
+   stay on, ~1.5KB would hold Timer2 off for ~375us. Only RAM below SP
+   is written, which an interrupt uses just while it runs and is done
+   with by the time the next byte goes in. One taken meanwhile leaves
+   its frame unpainted, the same depth it could reach during the call
+   being measured */
+void
+uu_stack_repaint ()
+{
+  uint8_t *p  = &_end;
+  uint8_t *sp = (uint8_t *)uu_stack_sp();
+
+  while (p <= sp)
+    *p++ = UU_STACK_PAINT;
+}
@@ -0,0 +1,60 @@
+/*
+  'UU' - Small AVR utility lib, stack usage
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_UU_STACK_H
+#define _HAVE_UU_STACK_H
+
+#include <stdint.h>
+
+/*
+ * Stack high water mark. Linking uu_stack.o paints the RAM between the
+ * end of .bss and the top of the stack with UU_STACK_PAINT before
+ * main() runs. Whatever the stack has since reached is no longer
+ * painted, uu_stack_low() finds the lowest such address by scanning up
+ * from .bss, so it costs ~5 cycles per free byte - fine every second
+ * or so, not every tick. There is no heap, nothing calls malloc().
+ *
+ * uu_stack_repaint() starts a fresh measurement below the caller's
+ * frame, for the depth of one call:
+ *
+ *   sp = uu_stack_sp();
+ *   uu_stack_repaint();
+ *   cycle();
+ *   depth = sp - uu_stack_low();
+ */
+
+#define UU_STACK_PAINT 0xc5
+
+#define uu_stack_sp() (SP)
+
+uint16_t
+uu_stack_low ();
+
+uint16_t
+uu_stack_free ();
+
+void
+uu_stack_repaint ();
+
+/* Bytes of stack at the deepest point seen, interrupts included */
+#define uu_stack_used() (RAMEND - uu_stack_low())
+
+#endif
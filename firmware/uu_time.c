@@ -0,0 +1,157 @@
+/*
+  'UU' - Small AVR utility lib, time keeping
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#include "uu.h"
+#include "uu_time.h"
+
+static volatile uint32_t _uu_ticks;
+static volatile uint32_t _uu_ms;
+static uint16_t          _uu_ms_frac; /* us into the current ms */
+
+static UUtimer *_uu_wheel[UU_WHEEL_SLOTS];
+static uint32_t _uu_wheel_at;         /* start of the next slot to run */
+
+#define uu_wheel_slot(ms) \
+  (&_uu_wheel[((ms) >> UU_WHEEL_SHIFT) & (UU_WHEEL_SLOTS - 1)])
+
+/* From the timer interrupt */
+void
+uu_time_tick ()
+{
+  _uu_ticks++;
+
+  _uu_ms_frac += UU_TIME_TICK_US;
+  if (_uu_ms_frac >= 1000)
+    {
+      _uu_ms_frac -= 1000;
+      _uu_ms++;
+    }
+}
+
+uint32_t
+uu_time_us ()
+{
+  uint8_t  sreg = SREG;
+  uint32_t ticks;
+  uint8_t  count;
+
+  cli();
+  ticks = _uu_ticks;
+  count = UU_TIME_TCNT;
+  /* matched and cleared, interrupt not run yet */
+  if (uu_bit_is_set(UU_TIME_TIFR, UU_TIME_OCF))
+    {
+      ticks++;
+      count = UU_TIME_TCNT;
+    }
+  SREG = sreg;
+
+  return ticks * UU_TIME_TICK_US + count / UU_TIME_COUNTS_PER_US;
+}
+
+uint32_t
+uu_time_ms ()
+{
+  uint8_t  sreg = SREG;
+  uint32_t ms;
+
+  cli();
+  ms = _uu_ms;
+  SREG = sreg;
+
+  return ms;
+}
+
+void
+uu_timer_cancel (UUtimer *t)
+{
+  UUtimer **p;
+
+  if (!t->armed)
+    return;
+
+  for (p = uu_wheel_slot(t->due); *p; p = &(*p)->next)
+    if (*p == t)
+      {
+	*p = t->next;
+	break;
+      }
+
+  t->armed = FALSE;
+}
+
+/* Calls fn(arg) from uu_time_run() once ms have passed. 0 is taken as
+   1, so a timer started from a callback is never due in the same run */
+void
+uu_timer_start (UUtimer *t, uint32_t ms, void (*fn) (void *arg), void *arg)
+{
+  UUtimer **p;
+
+  uu_timer_cancel(t);
+
+  if (!ms)
+    ms = 1;
+
+  t->due   = uu_time_ms() + ms;
+  t->fn    = fn;
+  t->arg   = arg;
+  t->armed = TRUE;
+
+  p = uu_wheel_slot(t->due);
+  t->next = *p;
+  *p = t;
+}
+
+/* Fire whatever is due, catching up on any slots missed */
+void
+uu_time_run ()
+{
+  uint32_t  now = uu_time_ms();
+  UUtimer **p, *t;
+
+  for (;;)
+    {
+      p = uu_wheel_slot(_uu_wheel_at);
+
+      while ((t = *p))
+	{
+	  if (!uu_time_reached(now, t->due))
+	    {
+	      p = &t->next;
+	      continue;
+	    }
+
+	  *p = t->next;
+	  t->armed = FALSE;
+	  t->fn(t->arg);
+
+	  /* The callback may have started or cancelled timers in this
+	     slot, p included, so walk it again from the top */
+	  p = uu_wheel_slot(_uu_wheel_at);
+	}
+
+      /* slot still current, later timers in it wait for next time */
+      if ((int32_t)(now - _uu_wheel_at) < UU_WHEEL_SLOT_MS)
+	break;
+
+      _uu_wheel_at += UU_WHEEL_SLOT_MS;
+    }
+}
@@ -0,0 +1,87 @@
+/*
+  'UU' - Small AVR utility lib, time keeping
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_UU_TIME_H
+#define _HAVE_UU_TIME_H
+
+#include <stdint.h>
+
+/*
+ * Free running clock, deadlines and one-shot timers. The application
+ * owns the timer: call uu_time_tick() from its interrupt every
+ * UU_TIME_TICK_US, and uu_time_us() adds the counter's progress into
+ * the current tick for ~1us resolution. Times wrap (us after ~71 min,
+ * ms after ~49 days) so compare with uu_time_reached(), never '<'.
+ *
+ * Timers are caller owned UUtimer structs hashed onto a wheel by due
+ * time. Callbacks run from uu_time_run() in the main loop, not from
+ * the interrupt, and may start or cancel any timer, their own too.
+ */
+
+#ifndef UU_TIME_TICK_US
+#define UU_TIME_TICK_US        125 /* Timer2 CTC at 8kHz */
+#define UU_TIME_TCNT           TCNT2
+#define UU_TIME_TIFR           TIFR2
+#define UU_TIME_OCF            OCF2A
+#define UU_TIME_COUNTS_PER_US  2   /* F_CPU / 8 */
+#endif
+
+#define UU_WHEEL_SLOTS   8          /* power of two */
+#define UU_WHEEL_SHIFT   4
+#define UU_WHEEL_SLOT_MS (1 << UU_WHEEL_SHIFT)
+
+typedef struct _UUTimer
+{
+  struct _UUTimer *next;
+  uint32_t         due;   /* ms */
+  void           (*fn) (void *arg);
+  void            *arg;
+  uint8_t          armed;
+} UUtimer;
+
+void
+uu_time_tick ();
+
+uint32_t
+uu_time_us ();
+
+uint32_t
+uu_time_ms ();
+
+void
+uu_timer_start (UUtimer *t, uint32_t ms, void (*fn) (void *arg), void *arg);
+
+void
+uu_timer_cancel (UUtimer *t);
+
+void
+uu_time_run ();
+
+#define uu_time_reached(now, due) ((int32_t)((now) - (due)) >= 0)
+
+#define uu_deadline_us(us) (uu_time_us() + (us))
+#define uu_deadline_ms(ms) (uu_time_ms() + (ms))
+#define uu_deadline_passed_us(d) uu_time_reached(uu_time_us(), (d))
+#define uu_deadline_passed_ms(d) uu_time_reached(uu_time_ms(), (d))
+
+#define uu_timer_armed(t) ((t)->armed)
+
+#endif
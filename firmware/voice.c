@@ -0,0 +1,281 @@
+/*
+  'SID GUTS' firmware - paraphonic voices
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+#include "uu.h"
+#include "sid.h"
+#include "voice.h"
+#include "gate.h"
+
+/* SID frequency of C6..B6 with the 1MHz clock, lower octaves shift down */
+const uint16_t note_freq[12] PROGMEM = {
+  17557, 18601, 19708, 20879, 22121, 23436,
+  24830, 26306, 27871, 29528, 31284, 33144
+};
+
+Voice _voices[VOICE_N];
+
+static uint8_t _voice_mode;
+static uint8_t _voice_next;     /* round robin position */
+static uint8_t _voice_serial;
+static uint8_t _voice_waveform;
+static uint8_t _voice_ad;
+static uint8_t _voice_sr;
+
+static uint8_t _held[VOICE_HELD_N]; /* oldest first */
+static uint8_t _held_n;
+
+static uint8_t
+voice_base (uint8_t v)
+{
+  return v * SID_VOICE_2;
+}
+
+static unsigned int
+voice_note_freq (uint8_t note)
+{
+  uint8_t octave = (VOICE_NOTE_MAX - note) / 12;
+
+  return pgm_read_word(&note_freq[note % 12]) >> octave;
+}
+
+/* How long since voice was triggered or released, copes with wrap */
+static uint8_t
+voice_age (uint8_t v)
+{
+  return _voice_serial - _voices[v].serial;
+}
+
+static void
+held_remove (uint8_t note)
+{
+  uint8_t i, j;
+
+  for (i = 0, j = 0; i < _held_n; i++)
+    if (_held[i] != note)
+      _held[j++] = _held[i];
+
+  _held_n = j;
+}
+
+static void
+held_push (uint8_t note)
+{
+  uint8_t i;
+
+  held_remove(note);
+
+  if (_held_n == VOICE_HELD_N)
+    {
+      /* Forget the oldest */
+      for (i = 1; i < VOICE_HELD_N; i++)
+	_held[i-1] = _held[i];
+      _held_n--;
+    }
+
+  _held[_held_n++] = note;
+}
+
+static int8_t
+voice_find (uint8_t note)
+{
+  uint8_t v;
+
+  for (v = 0; v < VOICE_N; v++)
+    if (_voices[v].note == note)
+      return v;
+
+  return -1;
+}
+
+static uint8_t
+voice_pick ()
+{
+  uint8_t i, v, best = VOICE_N, age = 0;
+
+  if (_voice_mode == VOICE_ROUND_ROBIN)
+    {
+      for (i = 0; i < VOICE_N; i++)
+	{
+	  v = (_voice_next + i) % VOICE_N;
+	  if (_voices[v].note == VOICE_NOTE_NONE)
+	    break;
+	}
+
+      if (i == VOICE_N) /* all busy, steal the next in turn */
+	v = _voice_next;
+
+      _voice_next = (v + 1) % VOICE_N;
+      return v;
+    }
+
+  /* Last note - free voice released longest ago, else steal oldest */
+  for (v = 0; v < VOICE_N; v++)
+    if (_voices[v].note == VOICE_NOTE_NONE
+	&& (best == VOICE_N || voice_age(v) > age))
+      {
+	best = v;
+	age = voice_age(v);
+      }
+
+  if (best < VOICE_N)
+    return best;
+
+  for (v = 0; v < VOICE_N; v++)
+    if (best == VOICE_N || voice_age(v) > age)
+      {
+	best = v;
+	age = voice_age(v);
+      }
+
+  return best;
+}
+
+static void
+voice_start (uint8_t v, uint8_t note)
+{
+  uint8_t      base = voice_base(v);
+  unsigned int f = voice_note_freq(note);
+
+  SID_set(base + SID_FREQ_LO, f);
+  SID_set(base + SID_FREQ_HI, f>>8);
+
+  /* Steals and retriggers too, the restart drops any gate still on */
+  gate_note_on(v, _voice_waveform, _voice_ad, _voice_sr);
+
+  _voices[v].note = note;
+  _voices[v].serial = ++_voice_serial;
+}
+
+static void
+voice_stop (uint8_t v)
+{
+  gate_note_off(v, _voice_waveform);
+
+  _voices[v].note = VOICE_NOTE_NONE;
+  _voices[v].serial = ++_voice_serial;
+}
+
+void
+voice_init (uint8_t mode)
+{
+  uint8_t v;
+
+  _voice_mode = mode;
+  _voice_next = 0;
+  _voice_serial = 0;
+  _held_n = 0;
+
+  for (v = 0; v < VOICE_N; v++)
+    {
+      _voices[v].note = VOICE_NOTE_NONE;
+      _voices[v].serial = 0;
+    }
+}
+
+void
+voice_patch (uint8_t waveform, uint8_t ad, uint8_t sr, uint16_t pulse_width)
+{
+  uint8_t v, base;
+
+  _voice_waveform = waveform;
+  _voice_ad = ad;
+  _voice_sr = sr;
+
+  for (v = 0; v < VOICE_N; v++)
+    {
+      base = voice_base(v);
+
+      SID_set(base + SID_PW_LO, uu_bit_low_byte(pulse_width));
+      SID_set(base + SID_PW_HI, uu_bit_high_byte(pulse_width));
+      if (gate_pending(v))
+	{
+	  gate_note_on(v, waveform, ad, sr); /* restart with the new patch */
+	  continue;
+	}
+      SID_set(base + SID_AD, ad);
+      SID_set(base + SID_SR, sr);
+      SID_set(base + SID_CTRL, waveform
+	      | (_voices[v].note != VOICE_NOTE_NONE ? GATE_ON : 0));
+    }
+}
+
+/* Returns the voice now playing note */
+int8_t
+voice_note_on (uint8_t note)
+{
+  int8_t v;
+
+  if (note > VOICE_NOTE_MAX)
+    note = VOICE_NOTE_MAX;
+
+  held_push(note);
+
+  v = voice_find(note);
+  if (v < 0)
+    v = voice_pick();
+
+  voice_start(v, note);
+
+  return v;
+}
+
+/* Returns the voice released, or -1 if note was not sounding */
+int8_t
+voice_note_off (uint8_t note)
+{
+  int8_t  v;
+  uint8_t i;
+
+  if (note > VOICE_NOTE_MAX)
+    note = VOICE_NOTE_MAX;
+
+  held_remove(note);
+
+  v = voice_find(note);
+  if (v < 0)
+    return -1;
+
+  if (_voice_mode == VOICE_LAST_NOTE)
+    {
+      /* Hand the voice back to the newest held note that lost its own */
+      for (i = _held_n; i > 0; i--)
+	if (voice_find(_held[i-1]) < 0)
+	  {
+	    voice_start(v, _held[i-1]);
+	    return v;
+	  }
+    }
+
+  voice_stop(v);
+
+  return v;
+}
+
+void
+voice_all_off ()
+{
+  uint8_t v;
+
+  for (v = 0; v < VOICE_N; v++)
+    if (_voices[v].note != VOICE_NOTE_NONE)
+      voice_stop(v);
+
+  _held_n = 0;
+}
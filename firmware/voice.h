@@ -0,0 +1,66 @@
+/*
+  'SID GUTS' firmware - paraphonic voices
+
+  Copyright (c) 2014 ALMCo Ltd
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General
+  Public License along with this library; if not, write to the
+  Free Software Foundation, Inc., 59 Temple Place, Suite 330,
+  Boston, MA  02111-1307  USA
+*/
+
+#ifndef _HAVE_VOICE_H
+#define _HAVE_VOICE_H
+
+#include <stdint.h>
+
+/*
+ * Note events over the three SID voices. Register changes are queued
+ * with SID_set(), the caller sends them with SID_flush() once per tick
+ * so a burst of events only costs the registers that ended up changed.
+ * Gates are the exception, note on is a hard restart timed by Timer2
+ * (gate.h) and note off is written straight away.
+ * The filter is shared and left to the caller.
+ *
+ * Notes are MIDI numbers, 0..VOICE_NOTE_MAX.
+ *
+ * Not in the firmware build yet: the panel has no note source to feed
+ * it and node_unison drives voices 2 and 3. Only voicetest builds it.
+ */
+
+#define VOICE_N         3
+#define VOICE_NOTE_NONE 0xff
+#define VOICE_NOTE_MAX  95  /* B6, top of note_freq[] without overflow */
+#define VOICE_HELD_N    8   /* notes remembered for last note priority */
+
+/* Allocation modes */
+#define VOICE_ROUND_ROBIN 0 /* rotate through voices, steal the next one */
+#define VOICE_LAST_NOTE   1 /* newest note always sounds, steals oldest
+			       and gets back stolen notes on release */
+
+typedef struct _Voice
+{
+  uint8_t note;   /* sounding note, VOICE_NOTE_NONE once released */
+  uint8_t serial; /* when last triggered or released */
+} Voice;
+
+extern Voice _voices[VOICE_N];
+
+void   voice_init (uint8_t mode);
+void   voice_patch (uint8_t waveform, uint8_t ad, uint8_t sr,
+		    uint16_t pulse_width);
+int8_t voice_note_on (uint8_t note);
+int8_t voice_note_off (uint8_t note);
+void   voice_all_off ();
+
+#endif